@@ -0,0 +1,152 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for board sized buffers. It is sized once up front,
+ * hands out aligned blocks and is reset back to a mark in O(1), so a new
+ * game reuses the same memory without touching malloc. Large arenas are
+ * backed by huge pages where the OS has them (on Linux, define
+ * _DEFAULT_SOURCE before including system headers), and are only
+ * reserved: a page costs memory once it is first written, so room sized
+ * for the worst case is free until a game needs it.
+ */
+
+#define ARENA_ALIGN 64                 /* cache line */
+#define ARENA_HUGE_PAGE ((size_t)2 << 20)
+
+enum { ARENA_MALLOC, ARENA_MMAP, ARENA_HUGETLB };
+
+struct arena {
+    unsigned char *base;               /* ARENA_ALIGN aligned */
+    size_t size, used;
+    size_t top;                        /* most ever used: past it, mmap'd memory is still zero */
+    int backing;                       /* malloc, mmap or hugetlb mmap */
+    void *mem;                         /* what to hand back to free */
+};
+
+int arena_init(struct arena *a, size_t size);
+void *arena_alloc(struct arena *a, size_t n);
+void *arena_zalloc(struct arena *a, size_t n);
+void arena_reset(struct arena *a, size_t mark);
+void arena_free(struct arena *a);
+
+#endif
+
+#ifdef ARENA_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+
+/* reserve address space only, so a worst case sized arena isn't refused up front */
+#ifdef MAP_NORESERVE
+#define ARENA_NORESERVE MAP_NORESERVE
+#else
+#define ARENA_NORESERVE 0
+#endif
+#endif
+
+int
+arena_init(struct arena *a, size_t size)
+{
+    a->used = 0;
+    a->top = 0;
+    a->size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+#ifdef __linux__
+    if (a->size >= ARENA_HUGE_PAGE) {
+        size_t len = (a->size + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+        void *p;
+
+        /* reserved huge pages first, then transparent ones */
+#ifdef MAP_HUGETLB
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            a->base = p;
+            a->size = len;
+            a->backing = ARENA_HUGETLB;
+            return 1;
+        }
+#endif
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | ARENA_NORESERVE, -1, 0);
+        if (p != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(p, len, MADV_HUGEPAGE);
+#endif
+            a->base = p;
+            a->size = len;
+            a->backing = ARENA_MMAP;
+            return 1;
+        }
+    }
+#endif
+
+    a->mem = malloc(a->size + ARENA_ALIGN);
+    a->backing = ARENA_MALLOC;
+    if (!a->mem) return 0;
+    a->base = (unsigned char *)(((size_t)a->mem + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+    return 1;
+}
+
+/* n bytes aligned to ARENA_ALIGN, NULL when the arena is full */
+void *
+arena_alloc(struct arena *a, size_t n)
+{
+    void *p;
+
+    n = (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (n > a->size - a->used) return NULL;
+
+    p = a->base + a->used;
+    a->used += n;
+    if (a->used > a->top) a->top = a->used;
+    return p;
+}
+
+/*
+ * arena_alloc, zeroed. Only what an earlier alloc handed out is cleared:
+ * mmap'd memory past that has never been written, so its pages are left
+ * untouched rather than faulted in.
+ */
+void *
+arena_zalloc(struct arena *a, size_t n)
+{
+    unsigned char *p;
+    size_t top = a->top, dirty;
+
+    p = arena_alloc(a, n);
+    if (!p) return NULL;
+    if (a->backing == ARENA_MALLOC)
+        dirty = n;
+    else
+        dirty = top > (size_t)(p - a->base) ? top - (size_t)(p - a->base) : 0;
+    memset(p, 0, dirty < n ? dirty : n);
+    return p;
+}
+
+/* drop everything allocated since a->used was mark */
+void
+arena_reset(struct arena *a, size_t mark)
+{
+    a->used = mark;
+}
+
+void
+arena_free(struct arena *a)
+{
+#ifdef __linux__
+    if (a->backing != ARENA_MALLOC) {
+        munmap(a->base, a->size);
+        a->base = NULL;
+        return;
+    }
+#endif
+    free(a->mem);
+    a->base = NULL;
+}
+
+#endif
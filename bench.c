@@ -0,0 +1,264 @@
+/*
+ * bench: reveal throughput of the board layout it was built with, on one
+ * thread and shared out over all cores, which has to reveal the very
+ * same cells. ./build.sh bench builds it row-major and tiled
+ * (-DBOARD_TILED) and runs both on the same boards. bench noguess times
+ * solver.h's no-guess boards at the usual difficulties instead, on one
+ * core and then on all of them.
+ *
+ *     bench [width height mines | noguess]
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+
+#define BOARD_IMPLEMENTATION
+#include "board.h"
+
+#define SOLVER_IMPLEMENTATION
+#include "solver.h"
+
+#define TRIALS 5
+#define NOGUESS_THREADS 16
+
+static double
+now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+#ifdef BOARD_TILED
+#define LAYOUT "tiled"
+#else
+#define LAYOUT "row-major"
+#endif
+
+/* one thread of a no-guess run: its own board and solver, attempts taken in turn */
+struct noguess_thread {
+    pthread_t t;
+    struct arena a;
+    struct board b;
+    struct solver s;
+    int passed;
+};
+static int noguess_tried;
+static double noguess_end;
+
+static void *
+noguess_thread(void *data)
+{
+    struct noguess_thread *t = data;
+    int w = t->b.w, h = t->b.h;
+
+    t->passed = 0;
+    while (now() < noguess_end)
+        t->passed += solver_noguess(&t->s, &t->b, splitmix64_at(1, __atomic_fetch_add(&noguess_tried, 1, __ATOMIC_RELAXED)),
+                                    board_index(&t->b, w / 2, h / 2));
+    return NULL;
+}
+
+/* no-guess boards made in about a second on n threads, clicking the middle, and the time; -1 without memory */
+static int
+noguess_run(int w, int h, int nbomb, int n, int *tried, double *time)
+{
+    static struct noguess_thread t[NOGUESS_THREADS];
+    double t0;
+    int k, passed;
+
+    for (k = 0; k < n; k++) {
+        if (!arena_init(&t[k].a, board_memsize(w, h, nbomb) + solver_memsize(w, h) + 2 * ARENA_ALIGN)) return -1;
+        board_init(&t[k].b, w, h, nbomb, arena_alloc(&t[k].a, board_memsize(w, h, nbomb)));
+        solver_init(&t[k].s, w, h, arena_alloc(&t[k].a, solver_memsize(w, h)));
+    }
+    noguess_tried = 0;
+    t0 = now();
+    noguess_end = t0 + 1;
+    for (k = 1; k < n; k++)
+        pthread_create(&t[k].t, NULL, noguess_thread, &t[k]);
+    noguess_thread(&t[0]);
+    passed = t[0].passed;
+    for (k = 1; k < n; k++) {
+        pthread_join(t[k].t, NULL);
+        passed += t[k].passed;
+    }
+    *time = now() - t0;
+    for (k = 0; k < n; k++)
+        arena_free(&t[k].a);
+    *tried = noguess_tried;
+    return passed;
+}
+
+/* a shared reveal's worker k, on a thread of its own */
+struct open_thread {
+    pthread_t t;
+    struct board_flood *f;
+    int k;
+};
+
+static void *
+open_thread(void *data)
+{
+    struct open_thread *t = data;
+
+    board_open_work(t->f, t->k);
+    return NULL;
+}
+
+/* board_open on n threads; returns the count */
+static int
+open_shared(const struct board *b, int i, uint64_t *revealed, const uint64_t *flagged, int *out, int n)
+{
+    static struct open_thread t[BOARD_WORKERS];
+    struct board_flood f;
+    int k;
+
+    if (board_open_start(&f, b, i, revealed, flagged, out, n)) {
+        for (k = 1; k < n; k++) {
+            t[k].f = &f;
+            t[k].k = k;
+            pthread_create(&t[k].t, NULL, open_thread, &t[k]);
+        }
+        board_open_work(&f, 0);
+        for (k = 1; k < n; k++)
+            pthread_join(t[k].t, NULL);
+    }
+    return board_open_end(&f);
+}
+
+static int
+bench_noguess(void)
+{
+    static const struct { const char *name; int w, h, nbomb; } level[] = {
+        { "beginner", 9, 9, 10 },
+        { "intermediate", 16, 16, 40 },
+        { "expert", 30, 16, 99 },
+    };
+    int l, n, passed, tried, all, alltried;
+    double t, tall;
+
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) n = 1;
+    if (n > NOGUESS_THREADS) n = NOGUESS_THREADS;
+    for (l = 0; l < (int)(sizeof(level) / sizeof(level[0])); l++) {
+        passed = noguess_run(level[l].w, level[l].h, level[l].nbomb, 1, &tried, &t);
+        all = noguess_run(level[l].w, level[l].h, level[l].nbomb, n, &alltried, &tall);
+        if (passed < 0 || all < 0) {
+            fprintf(stderr, "couldn't allocate %d x %d board\n", level[l].w, level[l].h);
+            return 1;
+        }
+        printf("%-9s %-12s %d x %d, %d mines: %d of %d attempts passed, %.0f boards/s on 1 thread, %.0f on %d\n",
+               LAYOUT, level[l].name, level[l].w, level[l].h, level[l].nbomb, passed, tried, passed / t,
+               all / tall, n);
+    }
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct arena a;
+    struct board b;
+    uint64_t *revealed, *flagged, *single, *seen;
+    size_t words;
+    int *opened, w, h, nbomb, trial, start, n, x, y, nthread, j;
+    double t, gen, best, shared;
+    long long cells;
+
+    /* wide and shallow by default: the row above is 50k cells away */
+    w = 50000;
+    h = 1300;
+    nbomb = w / 10 * h / 10;
+    if (argc == 2 && !strcmp(argv[1], "noguess")) return bench_noguess();
+    if (argc == 4) {
+        w = atoi(argv[1]);
+        h = atoi(argv[2]);
+        nbomb = atoi(argv[3]);
+    }
+    if (!board_fits(w, h) || nbomb < 1 || nbomb >= (long long)w * h) {
+        fprintf(stderr, "usage: %s [width height mines | noguess]\n", argv[0]);
+        return 1;
+    }
+
+    words = BOARD_CELLS(w, h) / 64;
+    if (!arena_init(&a, board_memsize(w, h, nbomb) + words * 4 * sizeof(uint64_t)
+                        + BOARD_OPEN_ROOM(w, h) * sizeof(int) + 6 * ARENA_ALIGN)) {
+        fprintf(stderr, "couldn't allocate %d x %d board\n", w, h);
+        return 1;
+    }
+    board_init(&b, w, h, nbomb, arena_alloc(&a, board_memsize(w, h, nbomb)));
+    revealed = arena_alloc(&a, words * sizeof(uint64_t));
+    flagged = arena_alloc(&a, words * sizeof(uint64_t));
+    single = arena_alloc(&a, words * sizeof(uint64_t));
+    seen = arena_alloc(&a, words * sizeof(uint64_t));
+    opened = arena_alloc(&a, BOARD_OPEN_ROOM(w, h) * sizeof(int));
+    memset(flagged, 0, words * sizeof(uint64_t));
+
+    t = now();
+    board_generate(&b, 1);
+    gen = now() - t;
+
+    /* the same start cells for either layout: the first empty cells down the middle column */
+    start = -1;
+    for (y = 0; y < h && start < 0; y++)
+        if (!board_cell(&b, board_index(&b, w / 2, y))) start = board_index(&b, w / 2, y);
+    if (start < 0) {
+        fprintf(stderr, "no empty cell to start from\n");
+        return 1;
+    }
+
+    best = 0;
+    cells = 0;
+    for (trial = 0; trial < TRIALS; trial++) {
+        memset(revealed, 0, words * sizeof(uint64_t));
+        t = now();
+        n = board_open(&b, start, revealed, flagged, opened);
+        t = now() - t;
+        if (!best || t < best) best = t;
+        cells = n;
+    }
+    memcpy(single, revealed, words * sizeof(uint64_t));
+
+    /* the same reveal shared out, at least two ways so the shared path runs on one core too */
+    nthread = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthread < 2) nthread = 2;
+    if (nthread > BOARD_WORKERS) nthread = BOARD_WORKERS;
+    shared = 0;
+    for (trial = 0; trial < TRIALS; trial++) {
+        memset(revealed, 0, words * sizeof(uint64_t));
+        t = now();
+        n = open_shared(&b, start, revealed, flagged, opened, nthread);
+        t = now() - t;
+        if (!shared || t < shared) shared = t;
+
+        /* every cell once in opened, and just the cells one thread revealed */
+        memset(seen, 0, words * sizeof(uint64_t));
+        for (j = 0; j < n && !(seen[opened[j] >> 6] >> (opened[j] & 63) & 1); j++)
+            seen[opened[j] >> 6] |= 1ull << (opened[j] & 63);
+        if (n != cells || j < n || memcmp(revealed, single, words * sizeof(uint64_t))
+            || memcmp(seen, single, words * sizeof(uint64_t))) {
+            fprintf(stderr, "%s: reveal on %d threads differs from one: %d cells against %lld\n",
+                    LAYOUT, nthread, n, cells);
+            return 1;
+        }
+    }
+
+    board_xy(&b, start, &x, &y);
+    printf("%-9s %d x %d, %d mines: generate %.1f ms, reveal from (%d, %d) %lld cells in %.1f ms, %.1f Mcells/s, "
+           "on %d threads %.1f ms, %.1f Mcells/s\n",
+           LAYOUT, w, h, nbomb, gen * 1e3, x, y, cells, best * 1e3, cells / best * 1e-6,
+           nthread, shared * 1e3, cells / shared * 1e-6);
+
+    arena_free(&a);
+    return 0;
+}
@@ -0,0 +1,1445 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rng.h"
+
+/*
+ * A generated board: where the mines are and everything derived from
+ * them, reproducible from its seed. Nothing here depends on play, so the
+ * next board can be built on another thread while the current one is in
+ * use. The caller owns the memory: board_memsize() bytes, handed to
+ * board_init().
+ *
+ * Cells are packed two to a byte, the low nibble first, holding the
+ * number of neighbouring mines or BOARD_MINE. The same cell index also
+ * addresses the 1 bit planes the game keeps alongside, 64 cells a word.
+ *
+ * Cell number n = y * w + x is a mine when splitmix64_at(seed, n) is
+ * below a threshold. So board_mine_at() can answer for any cell, from any
+ * thread, without the nibbles. The rows are cut into chunks (bands of
+ * about BOARD_CHUNK_CELLS cells) with a threshold each: board_split deals
+ * the nbomb mines out to the chunks by multivariate hypergeometric draws,
+ * which keeps every layout of nbomb mines equally likely, then each
+ * chunk's threshold is picked to give it exactly its share. Chunks are
+ * placed, then counted, independently of each other, so the work can be
+ * spread over threads and the board is the same for a seed however many
+ * there are: board_generate is that on the calling thread.
+ *
+ * By default cells are row-major, rows BOARD_STRIDE(w) cells apart so a
+ * row starts on a word. Built with BOARD_TILED, the board is cut into
+ * 8x8 tiles stored tile row by tile row (block-linear), cells row-major
+ * inside a tile: a tile is one plane word and 32 bytes of nibbles, the
+ * cells above and below are usually in the same tile, and a flood fill
+ * can open a whole tile at once with shifts. Always go through
+ * board_index() and board_xy().
+ */
+
+#define BOARD_MINE 0xF
+#define BOARD_STRIDE(w) (((w) + 63) & ~63)
+
+#ifdef BOARD_TILED
+#define BOARD_ROWS(h) (((h) + 7) & ~7)
+#else
+#define BOARD_ROWS(h) (h)
+#endif
+
+/* cells in the board and in each plane, padding included */
+#define BOARD_CELLS(w, h) ((size_t)BOARD_STRIDE(w) * BOARD_ROWS(h))
+
+#define BOARD_CHUNK_CELLS (1 << 20)
+
+#define BOARD_WORKERS 16          /* most threads a board is generated or opened on */
+#define BOARD_FLOOD_BLOCK 4096    /* out slots a thread of a reveal takes at a time */
+#define BOARD_FLOOD_PARALLEL 128  /* queued blocks before a reveal is shared out */
+#define BOARD_FLOOD_BATCH 16      /* blocks a thread takes off a queue at a time */
+
+/* whether a w x h board can be made: cell indices, padding included, are ints */
+static inline bool
+board_fits(int w, int h)
+{
+    return w >= 1 && h >= 1 && w <= INT_MAX - 63 && h <= INT_MAX - 7 && BOARD_CELLS(w, h) <= INT_MAX;
+}
+
+/* room board_open() needs in out: every cell, plus the slots threads leave unused */
+#define BOARD_OPEN_ROOM(w, h) ((size_t)(w) * (h) + BOARD_WORKERS * BOARD_FLOOD_BLOCK)
+
+struct board_chunk {
+    uint64_t threshold;   /* its cells that hash below it are the mines */
+    int nmine;            /* mines in its rows; board_move() keeps it so */
+    int mine0;            /* where they start in the board's list */
+};
+
+/*
+ * Rows a chunk: whole tile rows, so tiled chunks never share a byte. The
+ * row-major layout uses the same bands, which keeps a seed's board the
+ * same in both.
+ */
+static inline int
+board_band(int w, int h)
+{
+    int band = BOARD_CHUNK_CELLS / w;
+
+    if (band < 1) band = 1;
+    band = (band + 7) & ~7;
+    return band < BOARD_ROWS(h) ? band : BOARD_ROWS(h);
+}
+
+#define BOARD_NCHUNK(w, h) (((h) + board_band(w, h) - 1) / board_band(w, h))
+
+/* what one thread needs to place chunks */
+struct board_scratch {
+    int sbits, scap;      /* radix digit bits and pick pool size */
+    uint32_t *hist;       /* 1 << sbits counts */
+    struct board_pick *pool;
+};
+
+/* one thread of a shared reveal: its queue, and the out slots it is filling */
+struct board_flood_worker {
+    int base, cap;        /* its slots in the board's tileq, for the chunks it owns */
+    int head, count;
+    int pos, end;
+    char lock;
+    char pad[64 - 6 * sizeof(int) - 1];
+};
+
+/*
+ * A reveal in progress. board_open_start() opens it on the calling
+ * thread, and once the frontier grows past BOARD_FLOOD_PARALLEL blocks
+ * hands what is queued to nworker threads, each owning the chunks
+ * c % nworker == k and stealing from the others when its own run dry.
+ */
+struct board_flood {
+    const struct board *b;
+    uint64_t *revealed;
+    const uint64_t *flagged;
+    int *out;
+    bool parallel;
+    int nworker;
+    int head, tail;       /* the calling thread's ring, before sharing out */
+    int pending;          /* blocks queued or being opened */
+    int taken;            /* out slots handed out */
+    struct board_flood_worker worker[BOARD_WORKERS];
+};
+
+struct board {
+    int w, h, stride, nbomb;
+    uint64_t seed;
+    int band, nchunk;     /* rows a chunk, chunks */
+    struct board_chunk *chunks;
+    uint64_t *edges;      /* mines in each chunk's first and last row, stride bits each */
+    unsigned char *cells; /* BOARD_CELLS nibbles */
+    int *mines;           /* the mined cells, nbomb of them */
+    int nopening;         /* connected regions of empty cells, -1 once mines moved till board_label */
+    int bbbv;             /* 3BV, fewest clicks that clear the board, likewise; shown when a game ends */
+    int nmoved;           /* mines board_move() moved, from and to; -1 when too many */
+    int moved[9][2];
+    int *runs;            /* scratch for board_label, O(stride) */
+    struct board_scratch scratch; /* board_generate's */
+    int *tileq;           /* board_open's queue of blocks, one slot each */
+    uint64_t *queued;     /* 1 bit per block, in tileq */
+};
+
+size_t board_memsize(int w, int h, int nbomb);
+void board_init(struct board *b, int w, int h, int nbomb, void *mem);
+size_t board_work_memsize(int w, int h);
+void board_init_work(struct board *b, int w, int h, int nbomb, void *mem);
+size_t board_scratch_memsize(int w, int h);
+void board_scratch_init(struct board_scratch *s, int w, int h, void *mem);
+void board_generate(struct board *b, uint64_t seed);
+void board_split(struct board *b, uint64_t seed);
+void board_place(struct board *b, int c, struct board_scratch *s);
+void board_count(struct board *b, int c);
+void board_finish(struct board *b);
+void board_label(struct board *b);
+void board_move(struct board *b, int from, int to);
+void board_clear(struct board *b, int i, bool opening);
+void board_copy(struct board *dst, const struct board *src);
+int board_open(const struct board *b, int i, uint64_t *revealed, const uint64_t *flagged, int *out);
+bool board_open_start(struct board_flood *f, const struct board *b, int i, uint64_t *revealed,
+                      const uint64_t *flagged, int *out, int nworker);
+void board_open_work(struct board_flood *f, int k);
+int board_open_end(struct board_flood *f);
+size_t board_popcount(const uint64_t *plane, size_t words);
+int board_covered_safe(const struct board *b, const uint64_t *revealed);
+
+#ifdef BOARD_TILED
+static inline int
+board_index(const struct board *b, int x, int y)
+{
+    return ((y >> 3) * (b->stride >> 3) + (x >> 3)) << 6 | (y & 7) << 3 | (x & 7);
+}
+
+static inline void
+board_xy(const struct board *b, int i, int *x, int *y)
+{
+    int t = i >> 6;
+    *x = (t % (b->stride >> 3)) << 3 | (i & 7);
+    *y = (t / (b->stride >> 3)) << 3 | (i >> 3 & 7);
+}
+#else
+static inline int
+board_index(const struct board *b, int x, int y)
+{
+    return y * b->stride + x;
+}
+
+static inline void
+board_xy(const struct board *b, int i, int *x, int *y)
+{
+    *x = i % b->stride;
+    *y = i / b->stride;
+}
+#endif
+
+static inline int
+board_cell(const struct board *b, int i)
+{
+    return b->cells[i >> 1] >> ((i & 1) << 2) & 0xF;
+}
+
+/*
+ * The same answer as the nibbles, from the seed and the few mines moved
+ * since. A board whose mines were moved around more than that has only
+ * the nibbles to go by.
+ */
+static inline bool
+board_mine_at(const struct board *b, int x, int y)
+{
+    int k, i;
+
+    if (b->nmoved) {
+        i = board_index(b, x, y);
+        if (b->nmoved < 0) return board_cell(b, i) == BOARD_MINE;
+        for (k = b->nmoved - 1; k >= 0; k--) {
+            if (b->moved[k][0] == i) return false;
+            if (b->moved[k][1] == i) return true;
+        }
+    }
+    return splitmix64_at(b->seed, (uint64_t)y * b->w + x) < b->chunks[y / b->band].threshold;
+}
+
+/* unpack n cells of a row from x0 on, one byte each */
+static inline void
+board_row(const struct board *b, int y, int x0, int n, unsigned char *out)
+{
+#ifdef BOARD_TILED
+    int j;
+    for (j = 0; j < n; j++)
+        out[j] = board_cell(b, board_index(b, x0 + j, y));
+#else
+    const unsigned char *p;
+    int i = y * b->stride + x0;
+
+    if (n > 0 && (i & 1)) {
+        *out++ = b->cells[i >> 1] >> 4;
+        i++;
+        n--;
+    }
+    for (p = b->cells + (i >> 1); n >= 2; n -= 2, p++) {
+        *out++ = *p & 0xF;
+        *out++ = *p >> 4;
+    }
+    if (n) *out = *p & 0xF;
+#endif
+}
+
+#endif
+
+#if defined(BOARD_IMPLEMENTATION) && !defined(BOARD_IMPLEMENTED)
+#define BOARD_IMPLEMENTED
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the AVX2 popcount is built whatever the flags and picked at run time */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BOARD_AVX2
+#include <immintrin.h>
+#endif
+
+#define BOARD_ALIGN(n) (((n) + 63) & ~(size_t)63)
+
+/* a cell whose hash shares the threshold's leading digits */
+struct board_pick {
+    uint64_t h;
+    int i;
+};
+
+/* radix digit for finding a threshold among n cells: 8 bits on small chunks, else 16 */
+#define BOARD_SBITS(n) ((n) < 65536 ? 8 : 16)
+
+/* cells that share the leading digits a pool can hold, every cell on small chunks */
+static int
+board_scap(size_t n)
+{
+    if (n < 65536) return (int)n;
+    n >>= 10;
+    return n < 256 ? 256 : n > 65536 ? 65536 : (int)n;
+}
+
+/* most runs of empty cells a row can hold, plus one */
+#define BOARD_RUNS(stride) ((stride) / 2 + 1)
+
+size_t
+board_scratch_memsize(int w, int h)
+{
+    size_t n = (size_t)board_band(w, h) * w;
+
+    return BOARD_ALIGN(((size_t)1 << BOARD_SBITS(n)) * sizeof(uint32_t))
+        + BOARD_ALIGN((size_t)board_scap(n) * sizeof(struct board_pick));
+}
+
+void
+board_scratch_init(struct board_scratch *s, int w, int h, void *mem)
+{
+    unsigned char *p = mem;
+    size_t n = (size_t)board_band(w, h) * w;
+
+    s->sbits = BOARD_SBITS(n);
+    s->scap = board_scap(n);
+    s->hist = (uint32_t *)p;     p += BOARD_ALIGN(((size_t)1 << s->sbits) * sizeof(uint32_t));
+    s->pool = (struct board_pick *)p;
+}
+
+size_t
+board_memsize(int w, int h, int nbomb)
+{
+    return BOARD_ALIGN(BOARD_CELLS(w, h) / 2) + BOARD_ALIGN((size_t)nbomb * sizeof(int))
+        + BOARD_ALIGN((size_t)BOARD_NCHUNK(w, h) * sizeof(struct board_chunk))
+        + board_work_memsize(w, h);
+}
+
+/* board_memsize() less the cells, mines and chunks, for a board kept elsewhere */
+size_t
+board_work_memsize(int w, int h)
+{
+    return BOARD_ALIGN((size_t)BOARD_RUNS(BOARD_STRIDE(w)) * 9 * sizeof(int))
+        + BOARD_ALIGN((size_t)BOARD_NCHUNK(w, h) * 2 * (BOARD_STRIDE(w) / 8))
+        + board_scratch_memsize(w, h)
+        + BOARD_ALIGN(BOARD_CELLS(w, h) / 64 * sizeof(int)) + BOARD_ALIGN(BOARD_CELLS(w, h) / 64 / 8 + 8);
+}
+
+void
+board_init(struct board *b, int w, int h, int nbomb, void *mem)
+{
+    unsigned char *p = mem;
+
+    b->cells = p;                p += BOARD_ALIGN(BOARD_CELLS(w, h) / 2);
+    b->mines = (int *)p;         p += BOARD_ALIGN((size_t)nbomb * sizeof(int));
+    b->chunks = (struct board_chunk *)p;
+    p += BOARD_ALIGN((size_t)BOARD_NCHUNK(w, h) * sizeof(struct board_chunk));
+    board_init_work(b, w, h, nbomb, p);
+}
+
+/*
+ * board_init() for a board whose cells, mines and chunks the caller
+ * points at itself, from board_work_memsize() bytes.
+ */
+void
+board_init_work(struct board *b, int w, int h, int nbomb, void *mem)
+{
+    unsigned char *p = mem;
+
+    b->w = w;
+    b->h = h;
+    b->stride = BOARD_STRIDE(w);
+    b->nbomb = nbomb;
+    b->band = board_band(w, h);
+    b->nchunk = BOARD_NCHUNK(w, h);
+    b->nmoved = 0;
+    b->runs = (int *)p;          p += BOARD_ALIGN((size_t)BOARD_RUNS(b->stride) * 9 * sizeof(int));
+    b->edges = (uint64_t *)p;    p += BOARD_ALIGN((size_t)b->nchunk * 2 * (b->stride / 8));
+    board_scratch_init(&b->scratch, w, h, p);
+    p += board_scratch_memsize(w, h);
+    b->tileq = (int *)p;         p += BOARD_ALIGN(BOARD_CELLS(w, h) / 64 * sizeof(int));
+    b->queued = (uint64_t *)p;
+    memset(b->queued, 0, BOARD_CELLS(w, h) / 64 / 8 + 8);
+}
+
+static void
+board_set(struct board *b, int i, int v)
+{
+    unsigned char *p = &b->cells[i >> 1];
+    *p = (i & 1) ? (*p & 0x0F) | v << 4 : (*p & 0xF0) | v;
+}
+
+static int
+board_find(int *parent, int a)
+{
+    while (parent[a] != a) a = parent[a] = parent[parent[a]];
+    return a;
+}
+
+static bool
+board_empty(const struct board *b, int x, int y)
+{
+    return x >= 0 && y >= 0 && x < b->w && y < b->h && !board_cell(b, board_index(b, x, y));
+}
+
+/*
+ * Count the openings and 3BV: one click per opening plus one per numbered
+ * cell that no opening uncovers. Openings are counted a row at a time
+ * over runs of empty cells, so this needs O(width) scratch rather than a
+ * label per cell. Every run starts as an opening of its own and every
+ * union with a touching run of the row above merges two. The runs of the
+ * row above carry ids that are equal exactly when they are connected.
+ */
+void
+board_label(struct board *b)
+{
+    int *px0, *px1, *pid, *cx0, *cx1, *parent, *remap, *t;
+    int R, x, y, i, np, nc, nid, p, c, ra, rb, dx, dy;
+    bool edge;
+
+    R = BOARD_RUNS(b->stride);
+    px0 = b->runs;
+    px1 = px0 + R;
+    pid = px1 + R;
+    cx0 = pid + R;
+    cx1 = cx0 + R;
+    parent = cx1 + R;
+    remap = parent + 2 * R;
+
+    b->nopening = 0;
+    np = 0;
+    for (y = 0; y < b->h; y++) {
+        nc = 0;
+        for (x = 0; x < b->w; x++) {
+            if (!board_empty(b, x, y)) continue;
+            cx0[nc] = x;
+            while (x + 1 < b->w && board_empty(b, x + 1, y)) x++;
+            cx1[nc++] = x;
+        }
+
+        /* nodes 0..np-1 are the ids above, np.. this row's runs */
+        for (i = 0; i < np + nc; i++) {
+            parent[i] = i;
+            remap[i] = -1;
+        }
+        b->nopening += nc;
+
+        /* runs touch, diagonals included, when they overlap by x +- 1 */
+        for (p = 0, c = 0; p < np && c < nc;) {
+            if (px1[p] + 1 >= cx0[c] && px0[p] <= cx1[c] + 1) {
+                ra = board_find(parent, pid[p]);
+                rb = board_find(parent, np + c);
+                if (ra != rb) {
+                    parent[rb] = ra;
+                    b->nopening--;
+                }
+            }
+            if (px1[p] < cx1[c]) p++; else c++;
+        }
+
+        nid = 0;
+        for (c = 0; c < nc; c++) {
+            ra = board_find(parent, np + c);
+            if (remap[ra] < 0) remap[ra] = nid++;
+            pid[c] = remap[ra];
+        }
+
+        t = px0; px0 = cx0; cx0 = t;
+        t = px1; px1 = cx1; cx1 = t;
+        np = nc;
+    }
+
+    b->bbbv = b->nopening;
+    for (y = 0; y < b->h; y++) {
+        for (x = 0; x < b->w; x++) {
+            c = board_cell(b, board_index(b, x, y));
+            if (!c || c == BOARD_MINE) continue;
+            edge = false;
+            for (dy = -1; dy <= 1 && !edge; dy++)
+                for (dx = -1; dx <= 1 && !edge; dx++)
+                    edge = board_empty(b, x + dx, y + dy);
+            if (!edge) b->bbbv++;
+        }
+    }
+}
+
+static int
+board_pick_cmp(const void *a, const void *b)
+{
+    uint64_t x = ((const struct board_pick *)a)->h, y = ((const struct board_pick *)b)->h;
+    return x < y ? -1 : x > y;
+}
+
+static double
+board_lchoose(double n, double k)
+{
+    return lgamma(n + 1) - lgamma(k + 1) - lgamma(n - k + 1);
+}
+
+/*
+ * Successes in n draws without replacement from N holding K, by inversion
+ * from the mode: the outcomes are visited mode first, then alternately
+ * above and below, subtracting each one's probability from a uniform u.
+ * That is O(standard deviation) steps and exact up to doubles.
+ */
+static int64_t
+board_hypergeometric(uint64_t *rng, int64_t N, int64_t K, int64_t n)
+{
+    int64_t lo, hi, mode, l, r;
+    double u, pl, pr;
+
+    lo = n - (N - K) > 0 ? n - (N - K) : 0;
+    hi = n < K ? n : K;
+    if (lo == hi) return lo;
+
+    mode = (int64_t)((double)(n + 1) * (K + 1) / (N + 2));
+    if (mode < lo) mode = lo;
+    if (mode > hi) mode = hi;
+
+    u = (splitmix64(rng) >> 11) * 0x1p-53;
+    pl = pr = exp(board_lchoose(K, mode) + board_lchoose(N - K, n - mode) - board_lchoose(N, n));
+    u -= pl;
+    for (l = r = mode; u > 0 && (l > lo || r < hi);) {
+        if (r < hi) {
+            pr *= (double)(K - r) * (n - r) / ((double)(r + 1) * (N - K - n + r + 1));
+            r++;
+            if ((u -= pr) <= 0) return r;
+        }
+        if (l > lo) {
+            pl *= (double)l * (N - K - n + l) / ((double)(K - l + 1) * (n - l + 1));
+            l--;
+            if ((u -= pl) <= 0) return l;
+        }
+    }
+    /* what rounding leaves of u goes to the mode */
+    return mode;
+}
+
+/* seed b and deal its nbomb mines out to the chunks */
+void
+board_split(struct board *b, uint64_t seed)
+{
+    uint64_t rng;
+    int64_t N, K, n, k;
+    int c, rows, mine0;
+
+    b->seed = seed;
+    b->nmoved = 0;
+    rng = ~seed;  /* a stream apart from the cells' */
+    N = (int64_t)b->w * b->h;
+    K = b->nbomb;
+    mine0 = 0;
+    for (c = 0; c < b->nchunk; c++) {
+        rows = b->h - c * b->band < b->band ? b->h - c * b->band : b->band;
+        n = (int64_t)rows * b->w;
+        k = board_hypergeometric(&rng, N, K, n);
+        b->chunks[c].nmine = (int)k;
+        b->chunks[c].mine0 = mine0;
+        mine0 += (int)k;
+        N -= n;
+        K -= k;
+    }
+}
+
+/*
+ * Lay out chunk c's mines: clear its cells, find the threshold with
+ * exactly its share of hashes below it and mark those cells. That is a
+ * radix select, one digit a pass over the hashes from the top, until the
+ * cells sharing the leading digits found so far fit the pool. The last
+ * pass lays out every mine below those digits and pools the rest to sort.
+ */
+void
+board_place(struct board *b, int c, struct board_scratch *s)
+{
+    struct board_chunk *ch = &b->chunks[c];
+    uint64_t h, prefix, *edge;
+    uint32_t rank, d, mask;
+    int x, y, y0, y1, k, n, shift, top, *mines;
+
+    y0 = c * b->band;
+    y1 = y0 + b->band < b->h ? y0 + b->band : b->h;
+    k = y0 + b->band < BOARD_ROWS(b->h) ? y0 + b->band : BOARD_ROWS(b->h);
+    memset(b->cells + (size_t)y0 * b->stride / 2, 0, (size_t)(k - y0) * b->stride / 2);
+
+    mines = b->mines + ch->mine0;
+    n = 0;
+    k = 0;
+    mask = (1u << s->sbits) - 1;
+    rank = ch->nmine;
+    prefix = 0;
+    shift = 64;
+    if (!rank) goto done;
+    if (rank == (uint32_t)(y1 - y0) * b->w) {
+        shift = 0;
+        prefix = UINT64_MAX;
+        goto pool;
+    }
+    do {
+        /* rank is how many mines are still to find among the cells under prefix */
+        top = shift;
+        shift -= s->sbits;
+        memset(s->hist, 0, (mask + 1) * sizeof(uint32_t));
+        for (y = y0; y < y1; y++) {
+            for (x = 0; x < b->w; x++) {
+                h = splitmix64_at(b->seed, (uint64_t)y * b->w + x);
+                if (top == 64 || h >> top == prefix) s->hist[h >> shift & mask]++;
+            }
+        }
+        for (d = 0; rank >= s->hist[d]; d++) rank -= s->hist[d];
+        prefix = prefix << s->sbits | d;
+    } while (s->hist[d] > (uint32_t)s->scap && shift);
+
+pool:
+    for (y = y0; y < y1; y++) {
+        for (x = 0; x < b->w; x++) {
+            h = splitmix64_at(b->seed, (uint64_t)y * b->w + x);
+            if (h >> shift < prefix) {
+                mines[n++] = board_index(b, x, y);
+            } else if (h >> shift == prefix && k < s->scap) {
+                s->pool[k].h = h;
+                s->pool[k++].i = board_index(b, x, y);
+            }
+        }
+    }
+
+    /* a tie at the threshold, odds of 2^-64 a pair, leaves a mine short */
+    qsort(s->pool, k, sizeof(*s->pool), board_pick_cmp);
+    prefix = rank < (uint32_t)k ? s->pool[rank].h : prefix << shift;
+    for (x = 0; x < k && s->pool[x].h < prefix; x++)
+        mines[n++] = s->pool[x].i;
+
+done:
+    ch->threshold = n ? prefix : 0;
+    ch->nmine = n;
+    for (k = 0; k < n; k++)
+        board_set(b, mines[k], BOARD_MINE);
+
+    /* the first and last rows, for the chunks above and below to count */
+    edge = b->edges + (size_t)c * 2 * (b->stride / 64);
+    memset(edge, 0, 2 * (b->stride / 8));
+    for (k = 0; k < n; k++) {
+        board_xy(b, mines[k], &x, &y);
+        if (y == y0) edge[x >> 6] |= 1ull << (x & 63);
+        if (y == y1 - 1) edge[b->stride / 64 + (x >> 6)] |= 1ull << (x & 63);
+    }
+}
+
+/* count a mine at (x, y) into its neighbours in rows y0 to y1 - 1 that aren't mines */
+static void
+board_adj_add(struct board *b, int x, int y, int y0, int y1)
+{
+    int dx, dy, nx, ny, j, c;
+
+    for (dy = -1; dy <= 1; dy++) {
+        ny = y + dy;
+        if (ny < y0 || ny >= y1) continue;
+        for (dx = -1; dx <= 1; dx++) {
+            nx = x + dx;
+            if (nx < 0 || nx >= b->w) continue;
+            j = board_index(b, nx, ny);
+            c = board_cell(b, j);
+            if (c != BOARD_MINE) board_set(b, j, c + 1);
+        }
+    }
+}
+
+/*
+ * Count into chunk c's cells its own mines and those in the rows either
+ * side of it, once every chunk is placed. Only c's cells are written;
+ * the neighbours' rows come from their edges.
+ */
+void
+board_count(struct board *b, int c)
+{
+    const struct board_chunk *ch = &b->chunks[c];
+    const uint64_t *edge;
+    uint64_t bits;
+    int k, x, y, y0, y1, words;
+
+    y0 = c * b->band;
+    y1 = y0 + b->band < b->h ? y0 + b->band : b->h;
+    for (k = 0; k < ch->nmine; k++) {
+        board_xy(b, b->mines[ch->mine0 + k], &x, &y);
+        board_adj_add(b, x, y, y0, y1);
+    }
+
+    words = b->stride / 64;
+    if (c > 0) {
+        edge = b->edges + (size_t)(c - 1) * 2 * words + words;
+        for (k = 0; k < words; k++)
+            for (bits = edge[k]; bits; bits &= bits - 1)
+                board_adj_add(b, k * 64 + __builtin_ctzll(bits), y0 - 1, y0, y1);
+    }
+    if (c + 1 < b->nchunk) {
+        edge = b->edges + (size_t)(c + 1) * 2 * words;
+        for (k = 0; k < words; k++)
+            for (bits = edge[k]; bits; bits &= bits - 1)
+                board_adj_add(b, k * 64 + __builtin_ctzll(bits), y1, y0, y1);
+    }
+}
+
+/* once every chunk is counted: close the gaps ties left in the mine list and label */
+void
+board_finish(struct board *b)
+{
+    int c, n;
+
+    n = 0;
+    for (c = 0; c < b->nchunk; c++) {
+        if (b->chunks[c].mine0 != n)
+            memmove(b->mines + n, b->mines + b->chunks[c].mine0, b->chunks[c].nmine * sizeof(int));
+        b->chunks[c].mine0 = n;
+        n += b->chunks[c].nmine;
+    }
+    b->nbomb = n;
+    board_label(b);
+}
+
+static bool
+board_among(const int *cells, int n, int i)
+{
+    while (n--)
+        if (cells[n] == i) return true;
+    return false;
+}
+
+/* set i's count from its neighbours, unless it is a mine */
+static void
+board_recount(struct board *b, int i)
+{
+    int x, y, dx, dy, nx, ny, n;
+
+    if (board_cell(b, i) == BOARD_MINE) return;
+    board_xy(b, i, &x, &y);
+    n = 0;
+    for (dy = -1; dy <= 1; dy++) {
+        for (dx = -1; dx <= 1; dx++) {
+            nx = x + dx;
+            ny = y + dy;
+            if (nx >= 0 && ny >= 0 && nx < b->w && ny < b->h)
+                n += board_cell(b, board_index(b, nx, ny)) == BOARD_MINE;
+        }
+    }
+    board_set(b, i, n);
+}
+
+/*
+ * Take list entry m out of chunk a's run of the mine list and put mine
+ * into chunk c's, moving one entry of each run in between across so the
+ * runs stay in order: O(chunks apart), whatever the list's length.
+ */
+static void
+board_regroup(struct board *b, int m, int a, int c, int mine)
+{
+    struct board_chunk *ch;
+    int g;
+
+    if (a < c) {
+        ch = &b->chunks[a];
+        b->mines[m] = b->mines[ch->mine0 + --ch->nmine];
+        for (g = a + 1; g < c; g++) {
+            ch = &b->chunks[g];
+            ch->mine0--;
+            b->mines[ch->mine0] = b->mines[ch->mine0 + ch->nmine];
+        }
+        ch = &b->chunks[c];
+        b->mines[--ch->mine0] = mine;
+        ch->nmine++;
+    } else if (a > c) {
+        ch = &b->chunks[a];
+        b->mines[m] = b->mines[ch->mine0++];
+        ch->nmine--;
+        for (g = a - 1; g > c; g--) {
+            ch = &b->chunks[g];
+            b->mines[ch->mine0 + ch->nmine] = b->mines[ch->mine0];
+            ch->mine0++;
+        }
+        ch = &b->chunks[c];
+        b->mines[ch->mine0 + ch->nmine++] = mine;
+    } else {
+        b->mines[m] = mine;
+    }
+}
+
+/*
+ * Move the mine at from to to, which has to be free: its list entry, the
+ * counts around both and the record board_mine_at() goes by. The list
+ * entry is found in from's chunk, and moves to to's, so a move costs a
+ * chunk's share of the list at most.
+ */
+void
+board_move(struct board *b, int from, int to)
+{
+    const struct board_chunk *ch;
+    int x, y, dx, dy, nx, ny, m, k, c, a, cell[2];
+
+    board_set(b, to, BOARD_MINE);
+    board_set(b, from, 0);
+
+    board_xy(b, from, &x, &y);
+    a = y / b->band;
+    ch = &b->chunks[a];
+    for (m = ch->mine0; b->mines[m] != from; m++)
+        ;
+    board_xy(b, to, &x, &y);
+    board_regroup(b, m, a, y / b->band, to);
+
+    cell[0] = from;
+    cell[1] = to;
+    for (c = 0; c < 2; c++) {
+        board_xy(b, cell[c], &x, &y);
+        for (dy = -1; dy <= 1; dy++) {
+            for (dx = -1; dx <= 1; dx++) {
+                nx = x + dx;
+                ny = y + dy;
+                if (nx >= 0 && ny >= 0 && nx < b->w && ny < b->h) board_recount(b, board_index(b, nx, ny));
+            }
+        }
+    }
+
+    if (b->nmoved >= 0 && b->nmoved < 9) {
+        k = b->nmoved++;
+        b->moved[k][0] = from;
+        b->moved[k][1] = to;
+    } else {
+        b->nmoved = -1;
+    }
+    b->nopening = b->bbbv = -1;
+}
+
+/* mines in row y, sixteen nibbles at a time; the padding past w never holds one */
+static int
+board_row_mines(const struct board *b, int y)
+{
+    uint64_t v;
+    int n = 0;
+#ifdef BOARD_TILED
+    const unsigned char *p = b->cells + ((size_t)(y >> 3) * (b->stride >> 3) * 32) + (y & 7) * 4;
+    uint32_t t;
+    int k;
+
+    /* 8 cells of the row in each tile, 4 bytes */
+    for (k = 0; k < b->stride >> 3; k += 2, p += 64) {
+        memcpy(&t, p, 4);
+        v = t;
+        memcpy(&t, p + 32, 4);
+        v |= (uint64_t)t << 32;
+        n += __builtin_popcountll(v & v >> 1 & v >> 2 & v >> 3 & 0x1111111111111111ull);
+    }
+#else
+    const unsigned char *p = b->cells + (size_t)y * b->stride / 2;
+    int k;
+
+    for (k = 0; k < b->stride / 16; k++, p += 8) {
+        memcpy(&v, p, 8);
+        n += __builtin_popcountll(v & v >> 1 & v >> 2 & v >> 3 & 0x1111111111111111ull);
+    }
+#endif
+    return n;
+}
+
+/* of clear's n cells, those in rows y0 to y1 - 1 that aren't mines */
+static int
+board_clear_free(const struct board *b, const int *clear, int n, int y0, int y1)
+{
+    int k, x, y, m = 0;
+
+    for (k = 0; k < n; k++) {
+        board_xy(b, clear[k], &x, &y);
+        m += y >= y0 && y < y1 && board_cell(b, clear[k]) != BOARD_MINE;
+    }
+    return m;
+}
+
+/*
+ * The r-th cell, in row order, of those that are neither mines nor in
+ * clear. A chunk's count is its rows less its run of the mine list, so
+ * the draw goes to a chunk, then a row of it by counting the row's mine
+ * nibbles, then a cell: a chunk's cells at most, however big the board.
+ */
+static int
+board_select_free(const struct board *b, const int *clear, int n, uint64_t r)
+{
+    const struct board_chunk *ch;
+    uint64_t f;
+    int c, x, y, y0, y1, i;
+
+    for (c = 0;; c++) {
+        ch = &b->chunks[c];
+        y0 = c * b->band;
+        y1 = y0 + b->band < b->h ? y0 + b->band : b->h;
+        f = (uint64_t)(y1 - y0) * b->w - ch->nmine - board_clear_free(b, clear, n, y0, y1);
+        if (r < f) break;
+        r -= f;
+    }
+    for (y = y0;; y++) {
+        f = b->w - board_row_mines(b, y) - board_clear_free(b, clear, n, y, y + 1);
+        if (r < f) break;
+        r -= f;
+    }
+    for (x = 0;; x++) {
+        i = board_index(b, x, y);
+        if (board_cell(b, i) == BOARD_MINE || board_among(clear, n, i)) continue;
+        if (!r--) return i;
+    }
+}
+
+/*
+ * Make cell i safe for a first click, and with opening the cells around
+ * it too, so the click opens a region. Each mine there goes to a cell
+ * drawn uniformly from the free ones outside, which leaves every layout
+ * of the mines that spares those cells equally likely: the same board as
+ * placing them after the click, without a new board. The cell is picked
+ * by its rank among the free cells rather than by drawing until one is
+ * free, and only the counts around the moved mines are redone, so this
+ * costs a few chunks' worth of work at most, however big or dense the
+ * board. 3BV and the openings are left unknown. Opening falls back to i
+ * alone when the mines wouldn't fit outside its neighbourhood.
+ */
+void
+board_clear(struct board *b, int i, bool opening)
+{
+    size_t cells = (size_t)b->w * b->h;
+    int clear[9], nclear, x, y, dx, dy, nx, ny, k, nfree;
+    uint64_t rng;
+
+    board_xy(b, i, &x, &y);
+    nclear = 0;
+    clear[nclear++] = i;
+    for (dy = -1; dy <= 1 && opening; dy++) {
+        for (dx = -1; dx <= 1; dx++) {
+            nx = x + dx;
+            ny = y + dy;
+            if ((dx || dy) && nx >= 0 && ny >= 0 && nx < b->w && ny < b->h)
+                clear[nclear++] = board_index(b, nx, ny);
+        }
+    }
+    if (cells - nclear < (size_t)b->nbomb) nclear = 1;
+
+    /* a stream of its own, per first click */
+    rng = splitmix64_at(splitmix64_at(b->seed, UINT64_MAX), (uint64_t)y * b->w + x);
+    for (k = 0; k < nclear; k++) {
+        if (board_cell(b, clear[k]) != BOARD_MINE) continue;
+        nfree = board_clear_free(b, clear, nclear, 0, b->h);
+        board_move(b, clear[k], board_select_free(b, clear, nclear, splitmix64(&rng) % (cells - b->nbomb - nfree)));
+    }
+}
+
+/* dst, the same size as src, becomes a copy of it */
+void
+board_copy(struct board *dst, const struct board *src)
+{
+    memcpy(dst->cells, src->cells, BOARD_CELLS(src->w, src->h) / 2);
+    memcpy(dst->mines, src->mines, (size_t)src->nbomb * sizeof(int));
+    memcpy(dst->chunks, src->chunks, (size_t)src->nchunk * sizeof(struct board_chunk));
+    dst->nbomb = src->nbomb;
+    dst->seed = src->seed;
+    dst->nopening = src->nopening;
+    dst->bbbv = src->bbbv;
+    dst->nmoved = src->nmoved;
+    memcpy(dst->moved, src->moved, sizeof(dst->moved));
+}
+
+/* the whole of generation on the calling thread */
+void
+board_generate(struct board *b, uint64_t seed)
+{
+    int c;
+
+    board_split(b, seed);
+    for (c = 0; c < b->nchunk; c++)
+        board_place(b, c, &b->scratch);
+    for (c = 0; c < b->nchunk; c++)
+        board_count(b, c);
+    board_finish(b);
+}
+
+/*
+ * Uncover cell i and, through empty cells, everything it opens, setting
+ * their bits in revealed. The flood goes a block at a time, a block being
+ * one plane word: an 8x8 tile when tiled, else 64 cells of a row. The
+ * empty cells of a block are grown with shifts, then whatever they touch
+ * in the 8 blocks around is seeded and those blocks queued. A block is
+ * queued at most once at a time, so the queues need a slot per block.
+ */
+#ifdef BOARD_TILED
+
+#define BOARD_BW 8
+#define BOARD_BH 8
+#define BOARD_COL0 0x0101010101010101ull
+#define BOARD_COL7 0x8080808080808080ull
+
+/* the cells of tile t that are on the board */
+static uint64_t
+board_block_valid(const struct board *b, int t)
+{
+    int tx = t % (b->stride >> 3) << 3, ty = t / (b->stride >> 3) << 3;
+    uint64_t row, m;
+
+    row = b->w - tx >= 8 ? 0xFF : (1u << (b->w - tx)) - 1;
+    m = row * BOARD_COL0;
+    if (b->h - ty < 8) m &= (1ull << ((b->h - ty) * 8)) - 1;
+    return m;
+}
+
+/* x and every cell of v it reaches through empty cells e, within the tile */
+static uint64_t
+board_block_grow(uint64_t x, uint64_t e, uint64_t v)
+{
+    uint64_t src, hz, d;
+
+    for (;;) {
+        src = x & e;
+        hz = src | (src << 1 & ~BOARD_COL0) | (src >> 1 & ~BOARD_COL7);
+        d = (hz | hz << 8 | hz >> 8) & v & ~x;
+        if (!d) return x;
+        x |= d;
+    }
+}
+
+#else
+
+#define BOARD_BW 64
+#define BOARD_BH 1
+
+/* the cells of word t of a row that are on the board */
+static uint64_t
+board_block_valid(const struct board *b, int t)
+{
+    int x0 = t % (b->stride >> 6) << 6;
+
+    return b->w - x0 >= 64 ? ~0ull : (1ull << (b->w - x0)) - 1;
+}
+
+/*
+ * x and every cell of v it reaches through empty cells e, within the word:
+ * a Kogge-Stone fill each way along the runs of empty cells, then their
+ * borders, in one go.
+ */
+static uint64_t
+board_block_grow(uint64_t x, uint64_t e, uint64_t v)
+{
+    uint64_t p = e & v, pu = p, pd = p, u, d;
+    int k;
+
+    u = d = x & e;
+    for (k = 1; k < 64; k <<= 1) {
+        u |= pu & u << k;
+        d |= pd & d >> k;
+        pu &= pu << k;
+        pd &= pd >> k;
+    }
+    u |= d;
+    return x | ((u | u << 1 | u >> 1) & v);
+}
+
+#endif
+
+/* the empty cells of block t, from its 32 bytes of nibbles */
+static uint64_t
+board_block_empty(const struct board *b, int t)
+{
+    const unsigned char *p = b->cells + (size_t)t * 32;
+    uint64_t v, x, e;
+    int q, k;
+
+    e = 0;
+    for (q = 0; q < 4; q++) {
+        for (v = 0, k = 7; k >= 0; k--) v = v << 8 | p[q * 8 + k];
+
+        /* one bit per nonzero nibble at 4j, then gathered into 16 bits */
+        x = (v | v >> 1 | v >> 2 | v >> 3) & 0x1111111111111111ull;
+        x = (x | x >> 3) & 0x0303030303030303ull;
+        x = (x | x >> 6) & 0x000F000F000F000Full;
+        x = (x | x >> 12) & 0x000000FF000000FFull;
+        x = (x | x >> 24) & 0xFFFF;
+        e |= (~x & 0xFFFF) << (q * 16);
+    }
+    return e;
+}
+
+/*
+ * Shared out, threads race to uncover cells: whichever sets a cell's bit
+ * in revealed lists it. Seeding a block sets its bits before it is
+ * queued, and a block is unqueued before its bits are read, so a block
+ * seeded while being opened gets opened again.
+ */
+static uint64_t
+board_flood_claim(struct board_flood *f, int t, uint64_t bits, uint64_t *now)
+{
+    uint64_t old;
+
+    if (f->parallel) {
+        old = __atomic_fetch_or(&f->revealed[t], bits, __ATOMIC_SEQ_CST);
+    } else {
+        old = f->revealed[t];
+        f->revealed[t] = old | bits;
+    }
+    *now = old | bits;
+    return bits & ~old;
+}
+
+static void
+board_flood_emit(struct board_flood *f, int k, int t, uint64_t bits)
+{
+    struct board_flood_worker *w = &f->worker[k];
+    int *out = f->out, pos = w->pos, end = w->end;
+
+    for (; bits; bits &= bits - 1) {
+        if (pos == end) {
+            pos = __atomic_fetch_add(&f->taken, BOARD_FLOOD_BLOCK, __ATOMIC_RELAXED);
+            end = pos + BOARD_FLOOD_BLOCK;
+        }
+        out[pos++] = t << 6 | __builtin_ctzll(bits);
+    }
+    w->pos = pos;
+    w->end = end;
+}
+
+static void
+board_flood_lock(struct board_flood_worker *w)
+{
+    while (__atomic_test_and_set(&w->lock, __ATOMIC_ACQUIRE))
+        ;
+}
+
+static void
+board_flood_unlock(struct board_flood_worker *w)
+{
+    __atomic_clear(&w->lock, __ATOMIC_RELEASE);
+}
+
+/* queue block t, in block row ty, unless it already is */
+static void
+board_flood_push(struct board_flood *f, int t, int ty)
+{
+    const struct board *b = f->b;
+    uint64_t bit = 1ull << (t & 63);
+    struct board_flood_worker *w;
+
+    if (!f->parallel) {
+        if (b->queued[t >> 6] & bit) return;
+        b->queued[t >> 6] |= bit;
+        b->tileq[f->tail++ % (int)(BOARD_CELLS(b->w, b->h) / 64)] = t;
+        return;
+    }
+
+    if (__atomic_fetch_or(&b->queued[t >> 6], bit, __ATOMIC_SEQ_CST) & bit) return;
+    __atomic_add_fetch(&f->pending, 1, __ATOMIC_SEQ_CST);
+    w = &f->worker[ty * BOARD_BH / b->band % f->nworker];
+    board_flood_lock(w);
+    b->tileq[w->base + (w->head + w->count) % w->cap] = t;
+    __atomic_store_n(&w->count, w->count + 1, __ATOMIC_RELAXED);
+    board_flood_unlock(w);
+}
+
+static void
+board_flood_unqueue(struct board_flood *f, int t)
+{
+    uint64_t *q = &f->b->queued[t >> 6];
+
+    if (f->parallel)
+        __atomic_and_fetch(q, ~(1ull << (t & 63)), __ATOMIC_SEQ_CST);
+    else
+        *q &= ~(1ull << (t & 63));
+}
+
+/* give block (tx, ty) the cells in seed that are still covered */
+static void
+board_flood_seed(struct board_flood *f, int k, int tx, int ty, uint64_t seed)
+{
+    const struct board *b = f->b;
+    uint64_t now;
+    int t;
+
+    if (!seed || tx < 0 || ty < 0 || tx >= (b->w + BOARD_BW - 1) / BOARD_BW
+        || ty >= (b->h + BOARD_BH - 1) / BOARD_BH)
+        return;
+    t = ty * (b->stride / BOARD_BW) + tx;
+    seed &= ~(__atomic_load_n(&f->revealed[t], __ATOMIC_RELAXED) | f->flagged[t]) & board_block_valid(b, t);
+    if (!seed) return;
+    seed = board_flood_claim(f, t, seed, &now);
+    if (!seed) return;
+    board_flood_emit(f, k, t, seed);
+    board_flood_push(f, t, ty);
+}
+
+/* grow block t's empty cells, then spill them into the blocks around */
+static void
+board_flood_block(struct board_flood *f, int k, int t)
+{
+    const struct board *b = f->b;
+    uint64_t x, e, v, g, d, src;
+    int tw = b->stride / BOARD_BW, tx = t % tw, ty = t / tw;
+
+    board_flood_unqueue(f, t);
+    x = __atomic_load_n(&f->revealed[t], __ATOMIC_SEQ_CST);
+    e = board_block_empty(b, t);
+    v = board_block_valid(b, t) & ~f->flagged[t];
+    for (;;) {
+        g = board_block_grow(x, e, v);
+        d = g & ~x;
+        if (!d) break;
+        board_flood_emit(f, k, t, board_flood_claim(f, t, d, &x));
+        /* more bits than grown: another thread seeded the block meanwhile */
+        if (x == g) break;
+    }
+
+    src = x & e;
+#ifdef BOARD_TILED
+    {
+        uint64_t hz = src | (src << 1 & ~BOARD_COL0) | (src >> 1 & ~BOARD_COL7);
+        uint64_t c0 = src & BOARD_COL0, c7 = src & BOARD_COL7;
+
+        board_flood_seed(f, k, tx, ty - 1, (hz & 0xFF) << 56);
+        board_flood_seed(f, k, tx, ty + 1, hz >> 56);
+        board_flood_seed(f, k, tx - 1, ty, (c0 | c0 << 8 | c0 >> 8) << 7);
+        board_flood_seed(f, k, tx + 1, ty, (c7 | c7 << 8 | c7 >> 8) >> 7);
+        board_flood_seed(f, k, tx - 1, ty - 1, (src & 1) << 63);
+        board_flood_seed(f, k, tx + 1, ty - 1, (src >> 7 & 1) << 56);
+        board_flood_seed(f, k, tx - 1, ty + 1, (src >> 56 & 1) << 7);
+        board_flood_seed(f, k, tx + 1, ty + 1, src >> 63);
+    }
+#else
+    {
+        uint64_t hz = src | src << 1 | src >> 1;
+        int dy;
+
+        board_flood_seed(f, k, tx, ty - 1, hz);
+        board_flood_seed(f, k, tx, ty + 1, hz);
+        for (dy = -1; dy <= 1; dy++) {
+            board_flood_seed(f, k, tx - 1, ty + dy, (src & 1) << 63);
+            board_flood_seed(f, k, tx + 1, ty + dy, src >> 63);
+        }
+    }
+#endif
+}
+
+/*
+ * Hand the calling thread's ring to nworker queues, one per thread, a
+ * queue taking the blocks of every nworker'th chunk. Each has a slot for
+ * every block of its chunks, carved out of tileq.
+ */
+static void
+board_flood_share(struct board_flood *f, int nworker)
+{
+    const struct board *b = f->b;
+    int ring[BOARD_FLOOD_PARALLEL + 16];
+    int nt = BOARD_CELLS(b->w, b->h) / 64, tw = b->stride / BOARD_BW;
+    int n, c, k, j, r0, r1, base, t;
+    struct board_flood_worker *w;
+
+    for (n = 0; f->head < f->tail; n++)
+        ring[n] = b->tileq[f->head++ % nt];
+
+    f->nworker = nworker;
+    f->taken = f->worker[0].pos;
+    for (k = 0; k < nworker; k++)
+        f->worker[k] = (struct board_flood_worker) { 0 };
+    for (c = 0; c < b->nchunk; c++) {
+        r0 = c * b->band;
+        r1 = r0 + b->band < BOARD_ROWS(b->h) ? r0 + b->band : BOARD_ROWS(b->h);
+        f->worker[c % nworker].cap += (r1 - r0) / BOARD_BH * tw;
+    }
+    for (base = 0, k = 0; k < nworker; k++) {
+        f->worker[k].base = base;
+        base += f->worker[k].cap;
+    }
+
+    for (j = 0; j < n; j++) {
+        t = ring[j];
+        w = &f->worker[t / tw * BOARD_BH / b->band % nworker];
+        b->tileq[w->base + w->count++] = t;
+    }
+    f->pending = n;
+    for (k = 0; k < nworker; k++)
+        f->worker[k].pos = f->worker[k].end = f->taken;
+    f->parallel = true;
+}
+
+/*
+ * Start uncovering cell i, on the calling thread. The cells uncovered go
+ * in out, which needs BOARD_OPEN_ROOM() slots. Flagged cells are never
+ * opened. Returns true when the frontier grew big enough to be shared
+ * out: then board_open_work(f, k) for k < nworker has to run on nworker
+ * threads before board_open_end(), which returns how many cells are in
+ * out. The revealed cells are the same either way; their order isn't.
+ */
+bool
+board_open_start(struct board_flood *f, const struct board *b, int i, uint64_t *revealed,
+                 const uint64_t *flagged, int *out, int nworker)
+{
+    int nt = BOARD_CELLS(b->w, b->h) / 64, tw = b->stride / BOARD_BW, t;
+
+    f->b = b;
+    f->revealed = revealed;
+    f->flagged = flagged;
+    f->out = out;
+    f->parallel = false;
+    f->nworker = 1;
+    f->head = f->tail = 0;
+    f->worker[0].pos = 0;
+    f->worker[0].end = -1;
+
+    board_flood_seed(f, 0, (i >> 6) % tw, (i >> 6) / tw, 1ull << (i & 63));
+    if (board_cell(b, i)) {
+        if (f->tail) board_flood_unqueue(f, b->tileq[0]);
+        return false;
+    }
+
+    while (f->head < f->tail) {
+        if (nworker > 1 && f->tail - f->head > BOARD_FLOOD_PARALLEL) {
+            board_flood_share(f, nworker);
+            return true;
+        }
+        t = b->tileq[f->head++ % nt];
+        board_flood_block(f, 0, t);
+    }
+    return false;
+}
+
+/* take up to a batch off worker o's queue, about half of it when stealing */
+static int
+board_flood_take(struct board_flood *f, int o, int *batch, bool steal)
+{
+    struct board_flood_worker *w = &f->worker[o];
+    int n, j;
+
+    if (!__atomic_load_n(&w->count, __ATOMIC_RELAXED)) return 0;
+    board_flood_lock(w);
+    n = steal ? (w->count + 1) / 2 : w->count;
+    if (n > BOARD_FLOOD_BATCH) n = BOARD_FLOOD_BATCH;
+    for (j = 0; j < n; j++)
+        batch[j] = f->b->tileq[w->base + (w->head + j) % w->cap];
+    w->head = (w->head + n) % w->cap;
+    __atomic_store_n(&w->count, w->count - n, __ATOMIC_RELAXED);
+    board_flood_unlock(w);
+    return n;
+}
+
+/* thread k of a shared reveal: its own chunks first, then anyone's */
+void
+board_open_work(struct board_flood *f, int k)
+{
+    int batch[BOARD_FLOOD_BATCH], n, j;
+
+    for (;;) {
+        for (n = j = 0; j < f->nworker && !n; j++)
+            n = board_flood_take(f, (k + j) % f->nworker, batch, j > 0);
+        if (!n) {
+            /* nothing queued; done unless a block being opened queues more */
+            if (!__atomic_load_n(&f->pending, __ATOMIC_SEQ_CST)) return;
+            continue;
+        }
+        for (j = 0; j < n; j++)
+            board_flood_block(f, k, batch[j]);
+        __atomic_sub_fetch(&f->pending, n, __ATOMIC_SEQ_CST);
+    }
+}
+
+/*
+ * The reveal's count of cells. Shared out, each thread leaves the end of
+ * its last run of slots unused; those gaps are filled from the top.
+ */
+int
+board_open_end(struct board_flood *f)
+{
+    int gs[BOARD_WORKERS], ge[BOARD_WORKERS], ng, n, top, g, j, p, s, e;
+
+    if (!f->parallel) return f->worker[0].pos;
+
+    n = f->taken;
+    for (ng = 0, j = 0; j < f->nworker; j++) {
+        s = f->worker[j].pos;
+        e = f->worker[j].end;
+        if (s == e) continue;
+        n -= e - s;
+        for (p = ng++; p > 0 && gs[p - 1] > s; p--) {
+            gs[p] = gs[p - 1];
+            ge[p] = ge[p - 1];
+        }
+        gs[p] = s;
+        ge[p] = e;
+    }
+
+    top = f->taken;
+    g = ng - 1;
+    for (j = 0; j < ng && gs[j] < n; j++) {
+        for (p = gs[j]; p < ge[j] && p < n; p++) {
+            /* the last slot still holding a cell */
+            for (top--; g >= 0 && top < ge[g]; g--)
+                if (top >= gs[g]) top = gs[g] - 1;
+            f->out[p] = f->out[top];
+        }
+    }
+    return n;
+}
+
+/* board_open_start() to the end on the calling thread; returns the count */
+int
+board_open(const struct board *b, int i, uint64_t *revealed, const uint64_t *flagged, int *out)
+{
+    struct board_flood f;
+
+    board_open_start(&f, b, i, revealed, flagged, out, 1);
+    return board_open_end(&f);
+}
+
+#ifdef BOARD_AVX2
+/* board_popcount 32 bytes at a time: each nibble's count is looked up with vpshufb and vpsadbw sums the bytes */
+__attribute__((target("avx2"))) static size_t
+board_popcount_avx2(const uint64_t *plane, size_t words)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i sum = _mm256_setzero_si256(), v, c;
+    size_t k, n;
+
+    for (k = 0; k + 4 <= words; k += 4) {
+        v = _mm256_loadu_si256((const __m256i *)(plane + k));
+        c = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+                            _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+    }
+    n = _mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1)
+        + _mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3);
+    for (; k < words; k++)
+        n += __builtin_popcountll(plane[k]);
+    return n;
+}
+#endif
+
+/* set bits in a plane of words, with AVX2 where the CPU has it */
+size_t
+board_popcount(const uint64_t *plane, size_t words)
+{
+    size_t k, n = 0;
+
+#ifdef BOARD_AVX2
+    if (__builtin_cpu_supports("avx2")) return board_popcount_avx2(plane, words);
+#endif
+    for (k = 0; k < words; k++)
+        n += __builtin_popcountll(plane[k]);
+    return n;
+}
+
+/*
+ * Safe cells still covered, counted from scratch: what the game keeps
+ * track of as cells open, for checking it. Revealed mines (a lost game
+ * shows them all) are taken off the plane's count.
+ */
+int
+board_covered_safe(const struct board *b, const uint64_t *revealed)
+{
+    size_t n = board_popcount(revealed, BOARD_CELLS(b->w, b->h) / 64);
+    int i, m;
+
+    for (i = 0; i < b->nbomb; i++) {
+        m = b->mines[i];
+        n -= revealed[m >> 6] >> (m & 63) & 1;
+    }
+    return b->w * b->h - b->nbomb - (int)n;
+}
+
+#endif
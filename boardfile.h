@@ -0,0 +1,227 @@
+#ifndef BOARDFILE_H
+#define BOARDFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+
+/*
+ * A board and its play state in a file mapped with mmap, so boards larger
+ * than memory only need the pages being played in it. The file is one
+ * header page followed by page aligned sections, in host byte order:
+ *
+ *     cells      BOARD_CELLS(w, h) / 2 bytes, board.h's nibbles
+ *     revealed   BOARD_CELLS(w, h) / 8 bytes, 1 bit per cell
+ *     flagged    the same
+ *     nflag      BOARD_CELLS(w, h) / 2 bytes, flags around each cell, a nibble each
+ *     mines      nbomb ints, board indices
+ *     chunks     nchunk struct board_chunk, the mines' thresholds
+ *
+ * Cell indices depend on the layout, so a file only opens in a build with
+ * the layout that wrote it. The mapping is shared: every store lands in
+ * the file and boardfile_sync() makes it durable (POSIX only).
+ */
+
+#define BOARDFILE_MAGIC "MINEBRD1"
+#define BOARDFILE_VERSION 4
+#define BOARDFILE_PAGE 4096
+
+struct boardfile_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t tiled;               /* written by a BOARD_TILED build */
+    uint32_t ready;               /* a whole board is in it */
+    uint32_t pad;
+    int32_t w, h, stride, nbomb;
+    int32_t band, nchunk;         /* board.h's chunking when it was written */
+    uint64_t seed;
+    int32_t nopening, bbbv;
+    int32_t state, boom;          /* the game's, as of the last sync */
+    int32_t nmoved, pad1;         /* board_clear()'s, for board_mine_at() */
+    int32_t moved[9][2];
+    uint64_t cells, revealed, flagged, nflag, mines, chunks; /* section offsets */
+    uint64_t size;
+};
+
+struct boardfile {
+    int fd;
+    unsigned char *map;
+    size_t size;
+    bool fresh;                   /* no board in it yet */
+    struct boardfile_header *hdr;
+    unsigned char *cells;
+    uint64_t *revealed, *flagged;
+    unsigned char *nflag;
+    int *mines;
+    struct board_chunk *chunks;
+};
+
+int boardfile_open(struct boardfile *f, const char *path, int w, int h, int nbomb);
+void boardfile_attach(struct boardfile *f, struct board *b);
+void boardfile_generating(struct boardfile *f);
+void boardfile_store(struct boardfile *f, const struct board *b);
+void boardfile_sync(struct boardfile *f, bool wait);
+void boardfile_close(struct boardfile *f);
+
+#endif
+
+#ifdef BOARDFILE_IMPLEMENTATION
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BOARDFILE_ALIGN(n) (((n) + BOARDFILE_PAGE - 1) & ~(uint64_t)(BOARDFILE_PAGE - 1))
+
+static void
+boardfile_layout(struct boardfile_header *hd, int w, int h, int nbomb)
+{
+    uint64_t plane = BOARD_CELLS(w, h) / 8;
+
+    memset(hd, 0, sizeof(*hd));
+    memcpy(hd->magic, BOARDFILE_MAGIC, 8);
+    hd->version = BOARDFILE_VERSION;
+#ifdef BOARD_TILED
+    hd->tiled = 1;
+#endif
+    hd->w = w;
+    hd->h = h;
+    hd->stride = BOARD_STRIDE(w);
+    hd->nbomb = nbomb;
+    hd->band = board_band(w, h);
+    hd->nchunk = BOARD_NCHUNK(w, h);
+    hd->boom = -1;
+    hd->cells = BOARDFILE_PAGE;
+    hd->revealed = hd->cells + BOARDFILE_ALIGN(BOARD_CELLS(w, h) / 2);
+    hd->flagged = hd->revealed + BOARDFILE_ALIGN(plane);
+    hd->nflag = hd->flagged + BOARDFILE_ALIGN(plane);
+    hd->mines = hd->nflag + BOARDFILE_ALIGN(BOARD_CELLS(w, h) / 2);
+    hd->chunks = hd->mines + BOARDFILE_ALIGN((uint64_t)nbomb * sizeof(int));
+    hd->size = hd->chunks + BOARDFILE_ALIGN((uint64_t)hd->nchunk * sizeof(struct board_chunk));
+}
+
+/*
+ * Map the board in path, creating it for a w x h board with nbomb mines
+ * when there is none yet; an existing file keeps its own size, read back
+ * from f->hdr. Returns 0 when the file can't be used.
+ */
+int
+boardfile_open(struct boardfile *f, const char *path, int w, int h, int nbomb)
+{
+    struct boardfile_header hd;
+    struct stat st;
+    void *p;
+
+    f->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (f->fd < 0) return 0;
+    if (fstat(f->fd, &st) < 0) goto fail;
+
+    if (st.st_size == 0) {
+        boardfile_layout(&hd, w, h, nbomb);
+        /* sparse: blocks are only allocated as pages get written */
+        if (ftruncate(f->fd, hd.size) < 0) goto fail;
+    } else {
+        if (pread(f->fd, &hd, sizeof(hd), 0) != sizeof(hd)) goto fail;
+        if (memcmp(hd.magic, BOARDFILE_MAGIC, 8) || hd.version != BOARDFILE_VERSION) goto fail;
+#ifdef BOARD_TILED
+        if (!hd.tiled) goto fail;
+#else
+        if (hd.tiled) goto fail;
+#endif
+        if (!board_fits(hd.w, hd.h) || hd.stride != BOARD_STRIDE(hd.w) || (uint64_t)st.st_size < hd.size
+            || hd.band != board_band(hd.w, hd.h) || hd.nchunk != BOARD_NCHUNK(hd.w, hd.h))
+            goto fail;
+    }
+
+    /* a file left mid generation gets a new board */
+    f->fresh = !hd.ready;
+    f->size = hd.size;
+    p = mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+    if (p == MAP_FAILED) goto fail;
+    f->map = p;
+    f->hdr = p;
+    if (st.st_size == 0) *f->hdr = hd;
+    f->cells = f->map + hd.cells;
+    f->revealed = (uint64_t *)(f->map + hd.revealed);
+    f->flagged = (uint64_t *)(f->map + hd.flagged);
+    f->nflag = f->map + hd.nflag;
+    f->mines = (int *)(f->map + hd.mines);
+    f->chunks = (struct board_chunk *)(f->map + hd.chunks);
+    if (st.st_size && !hd.ready) memset(f->revealed, 0, hd.mines - hd.revealed);
+
+    /* play touches a view's worth of rows here and there, not runs of pages */
+    madvise(f->map, f->size, MADV_RANDOM);
+    return 1;
+
+fail:
+    close(f->fd);
+    return 0;
+}
+
+/*
+ * Point b's cells, mines and chunks at the file. b comes from board_init_work() with
+ * the file's size; unless the file is fresh it takes the board in it.
+ */
+void
+boardfile_attach(struct boardfile *f, struct board *b)
+{
+    b->cells = f->cells;
+    b->mines = f->mines;
+    b->chunks = f->chunks;
+    if (f->fresh) return;
+
+    b->nbomb = f->hdr->nbomb;
+    b->seed = f->hdr->seed;
+    b->nopening = f->hdr->nopening;
+    b->bbbv = f->hdr->bbbv;
+    b->nmoved = f->hdr->nmoved;
+    memcpy(b->moved, f->hdr->moved, sizeof(b->moved));
+}
+
+/* about to generate into the file, which sweeps it front to back */
+void
+boardfile_generating(struct boardfile *f)
+{
+    f->hdr->ready = 0;
+    f->fresh = true;
+    madvise(f->cells, f->hdr->revealed - f->hdr->cells, MADV_SEQUENTIAL);
+}
+
+/* record a freshly generated, or just cleared, b in the header, back to play access */
+void
+boardfile_store(struct boardfile *f, const struct board *b)
+{
+    f->hdr->nbomb = b->nbomb;
+    f->hdr->seed = b->seed;
+    f->hdr->nopening = b->nopening;
+    f->hdr->bbbv = b->bbbv;
+    f->hdr->nmoved = b->nmoved;
+    memcpy(f->hdr->moved, b->moved, sizeof(f->hdr->moved));
+    f->hdr->ready = 1;
+    f->fresh = false;
+    madvise(f->cells, f->hdr->revealed - f->hdr->cells, MADV_RANDOM);
+}
+
+/*
+ * Checkpoint: write the dirty pages back. Without wait this only starts
+ * the writeback; with it, returns once the file on disk is what is mapped.
+ */
+void
+boardfile_sync(struct boardfile *f, bool wait)
+{
+    msync(f->map, f->size, wait ? MS_SYNC : MS_ASYNC);
+}
+
+void
+boardfile_close(struct boardfile *f)
+{
+    munmap(f->map, f->size);
+    close(f->fd);
+    f->map = NULL;
+}
+
+#endif
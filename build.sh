@@ -2,6 +2,28 @@
 
 INC="-I/usr/inlcude/SDL3 -I./glad/include/ -I../"
 SRC="glad/src/glad.c main.c"
-FLAGS="-Wall -std=c99 -lm -g -lGL -lSDL3"
+FLAGS="-Wall -std=c99 -lm -lGL -lSDL3"
+
+# ./build.sh release drops GL error checking along with the debug info,
+# ./build.sh tiled stores the board in 8x8 tiles (see board.h) and
+# ./build.sh bench times reveals and no-guess boards with both board layouts
+DEBUG="-g"
+for arg in "$@"; do
+    case "$arg" in
+    release) DEBUG="-O2 -DNDEBUG" ;;
+    tiled)   FLAGS="$FLAGS -DBOARD_TILED" ;;
+    bench)
+        gcc -Wall -std=c99 -O2 bench.c -lm -pthread -o bench || exit 1
+        gcc -Wall -std=c99 -O2 -DBOARD_TILED bench.c -lm -pthread -o bench_tiled || exit 1
+        ./bench && ./bench_tiled && ./bench noguess && ./bench_tiled noguess
+        exit $?
+        ;;
+    esac
+done
+FLAGS="$FLAGS $DEBUG"
+
+# decode the atlas once, at build time
+gcc -std=c99 -O2 mkatlas.c -lm -o mkatlas || exit 1
+./mkatlas tilemap.png tilemap_rgba.h || exit 1
 
 gcc $FLAGS $SRC $INC -o app
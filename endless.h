@@ -0,0 +1,532 @@
+#ifndef ENDLESS_H
+#define ENDLESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Unbounded board for endless mode. Whether a cell is a mine is a hash of
+ * the seed and its coordinates, so nothing exists until it is looked at.
+ * The plane is cut into ENDLESS_CHUNK square chunks kept in a hash map.
+ * A chunk holds the player's revealed and flagged bits for good, and a
+ * cache of its adjacency nibbles that is built when the chunk is first
+ * viewed or revealed and paged out again, least recently used first (a
+ * CLOCK sweep), once more than the budget is cached. A chunk with no
+ * player state left goes away with its cache.
+ *
+ * Coordinates are the player's. The first reveal may shift them against
+ * the hashed plane so that it lands on an empty cell, or at densities
+ * where none is near on the nearest cell that isn't a mine; the plane
+ * has no edges, so that is still a uniformly random board.
+ */
+
+#define ENDLESS_CHUNK 64
+#define ENDLESS_MIN_DENSITY 0.1   /* below this openings can run forever */
+#define ENDLESS_RINGS 32          /* squares around the first reveal searched for an empty cell */
+
+enum { ENDLESS_REVEALED = 1, ENDLESS_FLAGGED = 2 };
+
+struct endless_chunk {
+    int32_t cx, cy;
+    bool ref;                      /* used since the clock hand last passed */
+    unsigned char *cells;          /* ENDLESS_CHUNK^2 nibbles, NULL when paged out */
+    uint64_t revealed[ENDLESS_CHUNK];  /* one word per row */
+    uint64_t flagged[ENDLESS_CHUNK];
+};
+
+struct endless {
+    uint64_t seed;
+    uint64_t threshold;            /* a cell is a mine when its hash is below */
+    int32_t ox, oy;                /* player to plane offset, set by the first reveal */
+    bool started;
+
+    struct endless_chunk **slot;   /* open addressing, cap a power of two */
+    size_t cap, count;
+    size_t cached, budget;         /* chunks with cells, and how many may have */
+    size_t hand;                   /* clock position in slot */
+
+    int32_t *queue;                /* cascade still to open, x y pairs */
+    size_t qhead, qtail, qcap;     /* a ring of qcap pairs */
+
+    long long opened;              /* cells revealed */
+    bool lost;
+    int32_t boomx, boomy;          /* the mine that ended it */
+};
+
+int endless_init(struct endless *e, uint64_t seed, double density, size_t budget);
+void endless_reset(struct endless *e, uint64_t seed);
+void endless_free(struct endless *e);
+int endless_cell(struct endless *e, int32_t x, int32_t y);
+int endless_state(struct endless *e, int32_t x, int32_t y);
+void endless_row(struct endless *e, int32_t y, int32_t x0, int n, unsigned char *cells, unsigned char *state);
+bool endless_open(struct endless *e, int32_t x, int32_t y);
+bool endless_flag(struct endless *e, int32_t x, int32_t y);
+size_t endless_step(struct endless *e, size_t max);
+
+#endif
+
+#ifdef ENDLESS_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rng.h"
+
+#define ENDLESS_BYTES (ENDLESS_CHUNK * ENDLESS_CHUNK / 2)
+
+static int32_t
+endless_floor(int32_t v)
+{
+    return v >= 0 ? v / ENDLESS_CHUNK : -((-(int64_t)v + ENDLESS_CHUNK - 1) / ENDLESS_CHUNK);
+}
+
+static bool
+endless_mine(const struct endless *e, int32_t x, int32_t y)
+{
+    return splitmix64_at(e->seed, (uint64_t)(uint32_t)x << 32 | (uint32_t)y) < e->threshold;
+}
+
+static size_t
+endless_hash(int32_t cx, int32_t cy)
+{
+    uint64_t z = (uint64_t)(uint32_t)cx << 32 | (uint32_t)cy;
+    return (size_t)splitmix64(&z);
+}
+
+static struct endless_chunk **
+endless_find(struct endless *e, int32_t cx, int32_t cy)
+{
+    size_t i = endless_hash(cx, cy) & (e->cap - 1);
+    while (e->slot[i] && (e->slot[i]->cx != cx || e->slot[i]->cy != cy))
+        i = (i + 1) & (e->cap - 1);
+    return &e->slot[i];
+}
+
+static void
+endless_drop(struct endless *e, size_t i)
+{
+    size_t j, k;
+
+    free(e->slot[i]->cells);
+    free(e->slot[i]);
+    e->slot[i] = NULL;
+    e->count--;
+
+    /* backward shift, so lookups never need tombstones */
+    for (j = (i + 1) & (e->cap - 1); e->slot[j]; j = (j + 1) & (e->cap - 1)) {
+        k = endless_hash(e->slot[j]->cx, e->slot[j]->cy) & (e->cap - 1);
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            e->slot[i] = e->slot[j];
+            e->slot[j] = NULL;
+            i = j;
+        }
+    }
+}
+
+static bool
+endless_grow(struct endless *e)
+{
+    struct endless_chunk **old = e->slot;
+    size_t i, n = e->cap;
+
+    e->slot = calloc(n * 2, sizeof(*e->slot));
+    if (!e->slot) {
+        e->slot = old;
+        return false;
+    }
+    e->cap = n * 2;
+    for (i = 0; i < n; i++)
+        if (old[i]) *endless_find(e, old[i]->cx, old[i]->cy) = old[i];
+    free(old);
+    e->hand = 0;
+    return true;
+}
+
+static bool
+endless_idle(const struct endless_chunk *c)
+{
+    int i;
+    for (i = 0; i < ENDLESS_CHUNK; i++)
+        if (c->revealed[i] | c->flagged[i]) return false;
+    return true;
+}
+
+/* page out one cache, clock order; drops the chunk if nothing else is in it */
+static void
+endless_evict(struct endless *e)
+{
+    struct endless_chunk *c;
+
+    for (;; e->hand = (e->hand + 1) & (e->cap - 1)) {
+        c = e->slot[e->hand];
+        if (!c || !c->cells) continue;
+        if (c->ref) {
+            c->ref = false;
+            continue;
+        }
+        e->cached--;
+        if (endless_idle(c)) {
+            endless_drop(e, e->hand);
+        } else {
+            free(c->cells);
+            c->cells = NULL;
+        }
+        return;
+    }
+}
+
+/* the chunk record, made on first use; NULL when out of memory */
+static struct endless_chunk *
+endless_chunk(struct endless *e, int32_t cx, int32_t cy)
+{
+    struct endless_chunk **p;
+
+    if ((e->count + 1) * 4 > e->cap * 3 && !endless_grow(e)) return NULL;
+    p = endless_find(e, cx, cy);
+    if (!*p) {
+        *p = calloc(1, sizeof(**p));
+        if (!*p) return NULL;
+        (*p)->cx = cx;
+        (*p)->cy = cy;
+        e->count++;
+    }
+    (*p)->ref = true;
+    return *p;
+}
+
+/* the chunk with its cells cached, from the hash of a 66x66 window */
+static struct endless_chunk *
+endless_cells(struct endless *e, int32_t cx, int32_t cy)
+{
+    static bool mine[ENDLESS_CHUNK + 2][ENDLESS_CHUNK + 2];
+    struct endless_chunk *c, **p;
+    unsigned char *cells;
+    int x, y, dx, dy, n;
+    int32_t x0, y0;
+
+    p = endless_find(e, cx, cy);
+    if (*p && (*p)->cells) {
+        (*p)->ref = true;
+        return *p;
+    }
+
+    /* evicting first may move or drop records, so look up again after */
+    while (e->cached >= e->budget) endless_evict(e);
+    cells = malloc(ENDLESS_BYTES);
+    c = cells ? endless_chunk(e, cx, cy) : NULL;
+    if (!c) {
+        free(cells);
+        return NULL;
+    }
+
+    x0 = cx * ENDLESS_CHUNK - 1;
+    y0 = cy * ENDLESS_CHUNK - 1;
+    for (y = 0; y < ENDLESS_CHUNK + 2; y++)
+        for (x = 0; x < ENDLESS_CHUNK + 2; x++)
+            mine[y][x] = endless_mine(e, x0 + x, y0 + y);
+
+    memset(cells, 0, ENDLESS_BYTES);
+    for (y = 0; y < ENDLESS_CHUNK; y++) {
+        for (x = 0; x < ENDLESS_CHUNK; x++) {
+            if (mine[y + 1][x + 1]) {
+                n = 0xF;
+            } else {
+                n = 0;
+                for (dy = 0; dy < 3; dy++)
+                    for (dx = 0; dx < 3; dx++)
+                        n += mine[y + dy][x + dx];
+            }
+            cells[(y * ENDLESS_CHUNK + x) >> 1] |= n << ((x & 1) << 2);
+        }
+    }
+
+    c->cells = cells;
+    e->cached++;
+    return c;
+}
+
+int
+endless_init(struct endless *e, uint64_t seed, double density, size_t budget)
+{
+    memset(e, 0, sizeof(*e));
+    e->cap = 1024;
+    e->qcap = 4096;
+    e->slot = calloc(e->cap, sizeof(*e->slot));
+    e->queue = malloc(e->qcap * 2 * sizeof(*e->queue));
+    if (!e->slot || !e->queue) {
+        endless_free(e);
+        return 0;
+    }
+
+    if (density < ENDLESS_MIN_DENSITY) density = ENDLESS_MIN_DENSITY;
+    if (density > 1) density = 1;
+    e->threshold = splitmix64_threshold(density);
+    e->budget = budget / (sizeof(struct endless_chunk) + ENDLESS_BYTES);
+    if (e->budget < 16) e->budget = 16;
+    e->seed = seed;
+    return 1;
+}
+
+/* a new plane: every chunk goes, the tables stay */
+void
+endless_reset(struct endless *e, uint64_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < e->cap; i++) {
+        if (!e->slot[i]) continue;
+        free(e->slot[i]->cells);
+        free(e->slot[i]);
+        e->slot[i] = NULL;
+    }
+    e->count = e->cached = e->hand = 0;
+    e->qhead = e->qtail = 0;
+    e->seed = seed;
+    e->ox = e->oy = 0;
+    e->started = false;
+    e->opened = 0;
+    e->lost = false;
+}
+
+void
+endless_free(struct endless *e)
+{
+    if (e->slot) endless_reset(e, 0);
+    free(e->slot);
+    free(e->queue);
+    e->slot = NULL;
+    e->queue = NULL;
+}
+
+/* adjacency nibble of a cell, or 0xF for a mine, in player coordinates; -1 when out of memory */
+int
+endless_cell(struct endless *e, int32_t x, int32_t y)
+{
+    struct endless_chunk *c;
+    int32_t cx, cy;
+
+    x += e->ox;
+    y += e->oy;
+    cx = endless_floor(x);
+    cy = endless_floor(y);
+    c = endless_cells(e, cx, cy);
+    if (!c) return -1;
+    x -= cx * ENDLESS_CHUNK;
+    y -= cy * ENDLESS_CHUNK;
+    return c->cells[(y * ENDLESS_CHUNK + x) >> 1] >> ((x & 1) << 2) & 0xF;
+}
+
+/* ENDLESS_REVEALED, ENDLESS_FLAGGED or 0, without building anything */
+int
+endless_state(struct endless *e, int32_t x, int32_t y)
+{
+    struct endless_chunk *c;
+    int32_t cx, cy;
+
+    x += e->ox;
+    y += e->oy;
+    cx = endless_floor(x);
+    cy = endless_floor(y);
+    c = *endless_find(e, cx, cy);
+    if (!c) return 0;
+    x -= cx * ENDLESS_CHUNK;
+    y -= cy * ENDLESS_CHUNK;
+    return (c->revealed[y] >> x & 1) * ENDLESS_REVEALED | (c->flagged[y] >> x & 1) * ENDLESS_FLAGGED;
+}
+
+/* n cells of row y from x0: nibbles and state, one chunk lookup per 64 */
+void
+endless_row(struct endless *e, int32_t y, int32_t x0, int n, unsigned char *cells, unsigned char *state)
+{
+    struct endless_chunk *c;
+    int32_t cx, cy, x, lx, ly;
+    int j;
+
+    y += e->oy;
+    x0 += e->ox;
+    cy = endless_floor(y);
+    ly = y - cy * ENDLESS_CHUNK;
+    c = NULL;
+    cx = 0;
+    for (j = 0; j < n; j++) {
+        x = x0 + j;
+        if (!c || endless_floor(x) != cx) {
+            cx = endless_floor(x);
+            c = endless_cells(e, cx, cy);
+        }
+        if (!c) {
+            cells[j] = 0;
+            state[j] = 0;
+            continue;
+        }
+        lx = x - cx * ENDLESS_CHUNK;
+        cells[j] = c->cells[(ly * ENDLESS_CHUNK + lx) >> 1] >> ((lx & 1) << 2) & 0xF;
+        state[j] = (c->revealed[ly] >> lx & 1) * ENDLESS_REVEALED | (c->flagged[ly] >> lx & 1) * ENDLESS_FLAGGED;
+    }
+}
+
+/* reveal (x, y) in plane coordinates; 0 when already open or flagged, -1 when out of memory */
+static int
+endless_mark(struct endless *e, int32_t x, int32_t y)
+{
+    struct endless_chunk *c;
+    int32_t cx = endless_floor(x), cy = endless_floor(y);
+    int lx, ly;
+
+    c = endless_chunk(e, cx, cy);
+    if (!c) return -1;
+    lx = x - cx * ENDLESS_CHUNK;
+    ly = y - cy * ENDLESS_CHUNK;
+    if ((c->revealed[ly] | c->flagged[ly]) >> lx & 1) return 0;
+    c->revealed[ly] |= 1ull << lx;
+    e->opened++;
+    return 1;
+}
+
+static void
+endless_push(struct endless *e, int32_t x, int32_t y)
+{
+    int32_t *q;
+    size_t i, n;
+
+    n = e->qtail - e->qhead;
+    if (n == e->qcap) {
+        /* unroll the ring into a buffer twice the size */
+        q = malloc(e->qcap * 4 * sizeof(*q));
+        if (!q) return;
+        for (i = 0; i < n; i++) {
+            q[i * 2] = e->queue[(e->qhead + i) % e->qcap * 2];
+            q[i * 2 + 1] = e->queue[(e->qhead + i) % e->qcap * 2 + 1];
+        }
+        free(e->queue);
+        e->queue = q;
+        e->qcap *= 2;
+        e->qhead = 0;
+        e->qtail = n;
+    }
+    e->queue[e->qtail % e->qcap * 2] = x;
+    e->queue[e->qtail % e->qcap * 2 + 1] = y;
+    e->qtail++;
+}
+
+/*
+ * Reveal (x, y). Returns true if it was a mine. The cascade it starts is
+ * only queued here; endless_step() opens it a bounded amount at a time.
+ * Out of memory nothing is revealed, and the first reveal is still to
+ * come.
+ */
+bool
+endless_open(struct endless *e, int32_t x, int32_t y)
+{
+    int32_t px, py, r, dx, dy, sx = 0, sy = 0;
+    bool safe = false;
+    int n;
+
+    if (!e->started) {
+        /*
+         * The nearest empty cell of the plane, on growing squares. At high
+         * densities one can be a billion cells away, so past ENDLESS_RINGS
+         * the nearest cell that isn't a mine does instead.
+         */
+        e->started = true;
+        for (r = 0; r <= ENDLESS_RINGS; r++) {
+            for (dy = -r; dy <= r; dy++) {
+                for (dx = -r; dx <= r; dx++) {
+                    if (dx != -r && dx != r && dy != -r && dy != r) continue;
+                    e->ox = dx;
+                    e->oy = dy;
+                    n = endless_cell(e, x, y);
+                    if (n < 0) goto fail;
+                    if (!n) goto found;
+                    if (n != 0xF && !safe) {
+                        safe = true;
+                        sx = dx;
+                        sy = dy;
+                    }
+                }
+            }
+        }
+        e->ox = sx;
+        e->oy = sy;
+    found:;
+    }
+
+    px = x + e->ox;
+    py = y + e->oy;
+    if ((n = endless_cell(e, x, y)) < 0 || endless_mark(e, px, py) <= 0) return false;
+    if (n == 0xF) {
+        e->lost = true;
+        e->boomx = x;
+        e->boomy = y;
+        return true;
+    }
+    endless_push(e, px, py);
+    return false;
+
+fail:
+    e->started = false;
+    e->ox = e->oy = 0;
+    return false;
+}
+
+/*
+ * Flag or unflag (x, y). Returns false if it is open, if out of memory,
+ * or before the first reveal, which can still move the plane under it.
+ * A chunk unflagged down to nothing, with no cache, goes.
+ */
+bool
+endless_flag(struct endless *e, int32_t x, int32_t y)
+{
+    struct endless_chunk *c;
+    int32_t cx, cy;
+    int lx, ly;
+
+    if (!e->started) return false;
+    x += e->ox;
+    y += e->oy;
+    cx = endless_floor(x);
+    cy = endless_floor(y);
+    c = endless_chunk(e, cx, cy);
+    if (!c) return false;
+    lx = x - cx * ENDLESS_CHUNK;
+    ly = y - cy * ENDLESS_CHUNK;
+    if (c->revealed[ly] >> lx & 1) return false;
+    c->flagged[ly] ^= 1ull << lx;
+    if (!c->cells && endless_idle(c)) endless_drop(e, endless_find(e, cx, cy) - e->slot);
+    return true;
+}
+
+/*
+ * Open at most max queued cells of the cascade; returns how many are
+ * left. Out of memory the cell stays at the head of the queue, to be
+ * tried again next step: its neighbours already opened are skipped then.
+ */
+size_t
+endless_step(struct endless *e, size_t max)
+{
+    int32_t x, y, dx, dy;
+    int n;
+
+    while (max-- && e->qhead != e->qtail) {
+        x = e->queue[e->qhead % e->qcap * 2];
+        y = e->queue[e->qhead % e->qcap * 2 + 1];
+        if ((n = endless_cell(e, x - e->ox, y - e->oy)) < 0) break;
+        if (n) {
+            e->qhead++;
+            continue;
+        }
+
+        for (dy = -1; dy <= 1; dy++) {
+            for (dx = -1; dx <= 1; dx++) {
+                if ((n = endless_mark(e, x + dx, y + dy)) < 0) goto stop;
+                if (n) endless_push(e, x + dx, y + dy);
+            }
+        }
+        e->qhead++;
+    }
+stop:
+    return e->qtail - e->qhead;
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Summary pyramid over the board. Level k holds one block per 2^k x 2^k
+ * cells with the number of revealed and flagged cells inside it (unknown
+ * is whatever is left of the block area). Blocks are drawn from
+ * LOD_MIN_LEVEL up, but only levels from LOD_BASE_LEVEL are stored; the
+ * caller counts the finer ones from its own cell state. The caller owns the
+ * memory: lod_memsize() bytes, handed to lod_init() which clears it.
+ */
+
+#define LOD_MIN_LEVEL  2
+#define LOD_BASE_LEVEL 4
+#define LOD_MAX_LEVEL  32
+
+enum { LOD_UNKNOWN, LOD_REVEALED, LOD_FLAGGED };
+
+struct lod_block { uint32_t revealed, flagged; };
+
+struct lod_level {
+    int w, h;                   /* size in blocks */
+    struct lod_block *blocks;
+};
+
+struct lod {
+    int w, h;                   /* board size in cells */
+    int top;                    /* coarsest level, a single block */
+    struct lod_level level[LOD_MAX_LEVEL];
+};
+
+size_t lod_memsize(int w, int h);
+void lod_init(struct lod *l, int w, int h, void *mem);
+void lod_update(struct lod *l, int x, int y, int from, int to);
+struct lod_block lod_get(const struct lod *l, int k, int bx, int by, int *area);
+int lod_pick_level(const struct lod *l, float cellpx, float minpx);
+
+#endif
+
+#ifdef LOD_IMPLEMENTATION
+
+#include <assert.h>
+#include <string.h>
+
+static int
+lod_top(int w, int h)
+{
+    int top;
+    for (top = LOD_BASE_LEVEL; (1 << top) < w || (1 << top) < h; top++);
+    return top;
+}
+
+size_t
+lod_memsize(int w, int h)
+{
+    size_t n = 0;
+    int k;
+
+    for (k = LOD_BASE_LEVEL; k <= lod_top(w, h); k++)
+        n += (size_t)((w + (1 << k) - 1) >> k) * (size_t)((h + (1 << k) - 1) >> k);
+    return n * sizeof(struct lod_block);
+}
+
+void
+lod_init(struct lod *l, int w, int h, void *mem)
+{
+    struct lod_block *b = mem;
+    int k;
+
+    l->w = w;
+    l->h = h;
+    l->top = lod_top(w, h);
+
+    for (k = 0; k < LOD_MAX_LEVEL; k++) {
+        l->level[k].w = l->level[k].h = 0;
+        l->level[k].blocks = NULL;
+    }
+
+    for (k = LOD_BASE_LEVEL; k <= l->top; k++) {
+        l->level[k].w = (w + (1 << k) - 1) >> k;
+        l->level[k].h = (h + (1 << k) - 1) >> k;
+        l->level[k].blocks = b;
+        b += (size_t)l->level[k].w * l->level[k].h;
+    }
+
+    memset(mem, 0, lod_memsize(w, h));
+}
+
+/* move cell (x, y) from one class to another, O(levels) */
+void
+lod_update(struct lod *l, int x, int y, int from, int to)
+{
+    struct lod_block *b;
+    int k;
+
+    if (from == to) return;
+
+    for (k = LOD_BASE_LEVEL; k <= l->top; k++) {
+        b = &l->level[k].blocks[(y >> k) * l->level[k].w + (x >> k)];
+        if (from == LOD_REVEALED) b->revealed--;
+        if (from == LOD_FLAGGED) b->flagged--;
+        if (to == LOD_REVEALED) b->revealed++;
+        if (to == LOD_FLAGGED) b->flagged++;
+    }
+}
+
+/* block (bx, by) of a stored level k; area is the board cells it covers */
+struct lod_block
+lod_get(const struct lod *l, int k, int bx, int by, int *area)
+{
+    int x0, y0, x1, y1;
+
+    assert(k >= LOD_BASE_LEVEL && k <= l->top);
+    x0 = bx << k; x1 = x0 + (1 << k);
+    y0 = by << k; y1 = y0 + (1 << k);
+    if (x1 > l->w) x1 = l->w;
+    if (y1 > l->h) y1 = l->h;
+    *area = (x1 - x0) * (y1 - y0);
+
+    return l->level[k].blocks[by * l->level[k].w + bx];
+}
+
+/*
+ * finest level from LOD_MIN_LEVEL whose blocks are at least minpx pixels
+ * wide; below LOD_BASE_LEVEL it is not stored, so the caller counts those
+ * blocks from its cell state instead of calling lod_get()
+ */
+int
+lod_pick_level(const struct lod *l, float cellpx, float minpx)
+{
+    int k;
+    for (k = LOD_MIN_LEVEL; k < l->top; k++)
+        if (cellpx * (float)(1 << k) >= minpx) break;
+    return k;
+}
+
+#endif
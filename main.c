@@ -1,8 +1,17 @@
+/* mmap flags and madvise for the board arena */
+#define _DEFAULT_SOURCE
+
 #include <glad/glad.h>
 
 #include <SDL3/SDL_init.h>
 #include <SDL3/SDL_error.h>
 #include <SDL3/SDL_opengl.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_timer.h>
+#include <SDL3/SDL_filesystem.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_cpuinfo.h>
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -10,13 +19,37 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <string.h>
+#include <math.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+/* generated by build.sh from tilemap.png */
+#include "tilemap_rgba.h"
+
 #define TILEMAP_IMPLEMENTATION
 #include "tilemap.h"
 
+#define LOD_IMPLEMENTATION
+#include "lod.h"
+
+#define ARENA_IMPLEMENTATION
+#include "arena.h"
+
+#include "rng.h"
+
+#define BOARD_IMPLEMENTATION
+#include "board.h"
+
+#define ENDLESS_IMPLEMENTATION
+#include "endless.h"
+
+#define BOARDFILE_IMPLEMENTATION
+#include "boardfile.h"
+
+#define SOLVER_IMPLEMENTATION
+#include "solver.h"
+
 const char *vertex_shader_source = "#version 330 core\n"
     "layout (location = 0) in vec2 pos;\n"
     "layout (location = 1) in vec2 texcoord;\n"
@@ -36,6 +69,24 @@ const char *fragment_shader_source = "#version 330 core\n"
     "    fColor = texture(tex0, vTexCoord);\n"
     "}\0";
 
+const char *overview_vertex_shader_source = "#version 330 core\n"
+    "layout (location = 0) in vec2 pos;\n"
+    "layout (location = 1) in vec4 color;\n"
+    "out vec4 vColor;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4(pos.x, pos.y, 1.0, 1.0);\n"
+    "    vColor = color;\n"
+    "}\0";
+
+const char *overview_fragment_shader_source = "#version 330 core\n"
+    "out vec4 fColor;\n"
+    "in vec4 vColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fColor = vColor;\n"
+    "}\0";
+
 static void
 sdl_err(int rc) {
     if (!rc) {
@@ -44,21 +95,69 @@ sdl_err(int rc) {
     }
 }
 
-#define XORSHIFT128_RAND_MAX ((uint32_t)0xFFFFFFFFu)
-uint32_t xorshift128_state[4] = { 0x01234567, 0x89abcdef, 0xfedcba98, 0x7654321 };
-uint32_t xorshift128(uint32_t *state);
-uint32_t xorshift128(uint32_t *state) {
-    uint32_t t, s;
-    t = state[3]; s = state[0];
-    state[3] = state[2];
-    state[2] = state[1];
-    state[1] = s;
-    t ^= t << 11; t ^= t >> 8;
-    return state[0] = t ^ s ^ (s >> 19);
+/*
+ * Debug builds report GL errors through a KHR_debug callback when the
+ * driver has one, and fall back to polling glGetError after each phase
+ * otherwise. Release builds (-DNDEBUG) do neither, so the render path has
+ * no sync points. Set MINESWEEPER_GL_SYNC to get the callback on the
+ * offending call's stack.
+ */
+#ifdef NDEBUG
+#define GL_ERR(msg) ((void)0)
+#else
+#define GL_ERR(msg) do { if (!gl_debug_output) check_gl_err(true, __LINE__, msg); } while (0)
+
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT                 0x92E0
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS     0x8242
+#define GL_DEBUG_TYPE_ERROR             0x824C
+#define GL_DEBUG_SEVERITY_NOTIFICATION  0x826B
+#endif
+
+typedef void (APIENTRY *gl_debug_proc)(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                       GLsizei length, const GLchar *message, const void *user);
+typedef void (APIENTRY *gl_debug_message_callback_fn)(gl_debug_proc callback, const void *user);
+typedef void (APIENTRY *gl_debug_message_control_fn)(GLenum source, GLenum type, GLenum severity,
+                                                     GLsizei count, const GLuint *ids, GLboolean enabled);
+
+static bool gl_debug_output;   /* callback installed, GL_ERR is a no-op */
+static bool gl_debug_sync;     /* callback runs on the offending call */
+static volatile bool gl_debug_error;
+
+static void APIENTRY
+gl_debug_message(GLenum source, GLenum type, GLuint id, GLenum severity,
+                 GLsizei length, const GLchar *message, const void *user)
+{
+    (void)source; (void)length; (void)user;
+    if (severity == GL_DEBUG_SEVERITY_NOTIFICATION) return;
+    printf("gldebug(0x%x):%s\n", id, message);
+    if (type != GL_DEBUG_TYPE_ERROR) return;
+    if (gl_debug_sync) exit(1);
+    /* may be on a driver thread, render() bails out at the end of the frame */
+    gl_debug_error = true;
+}
+
+static void
+gl_debug_init(void)
+{
+    gl_debug_message_callback_fn callback;
+    gl_debug_message_control_fn control;
+
+    if (!SDL_GL_ExtensionSupported("GL_KHR_debug")) return;
+
+    callback = (gl_debug_message_callback_fn)SDL_GL_GetProcAddress("glDebugMessageCallback");
+    control = (gl_debug_message_control_fn)SDL_GL_GetProcAddress("glDebugMessageControl");
+    if (!callback || !control) return;
+
+    gl_debug_sync = getenv("MINESWEEPER_GL_SYNC") != NULL;
+
+    glEnable(GL_DEBUG_OUTPUT);
+    if (gl_debug_sync) glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    control(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+    callback(gl_debug_message, NULL);
+    gl_debug_output = true;
 }
-static inline float randf(void){ return (float)xorshift128(xorshift128_state) / (float)XORSHIFT128_RAND_MAX; }
 
-#define GL_ERR(msg) check_gl_err(true, __LINE__, msg);
 static void check_gl_err(bool enable, int line, const char *msg) {
     GLenum err;
     bool error_occurred;
@@ -81,8 +180,109 @@ static void check_gl_err(bool enable, int line, const char *msg) {
     }
     if (error_occurred) exit(1);
 }
+#endif
+
+#define TILE 16            /* board pixels per cell */
+#define VIEW_MAX_W 1024    /* field views larger than this scroll */
+#define VIEW_MAX_H 768
+#define ZOOM_MAX 4.0f
+#define CELL_MIN_PX 8.0f   /* below this, cells are drawn as overview blocks */
+#define BLOCK_MIN_PX 4.0f  /* smallest overview block on screen */
+#define ENDLESS_BUDGET ((size_t)64 << 20) /* cached chunk bytes in endless mode */
+#define ENDLESS_STEP 65536 /* cascade cells opened per frame in endless mode */
+#define CHECKPOINT_MS 5000 /* board file writeback while a game goes on */
+#define NOGUESS_ATTEMPTS 4096 /* boards --noguess tries before settling for a plain first click */
+#define HINT_MS 200        /* longest a hint samples parts of the frontier too big to count */
+#define HINT_ERROR 0.01    /* ... or until every sampled chance is this close */
+#define HINT_STEPS 256     /* redraws per chain in the first round of sampling */
+#define CHROME_QUADS 16    /* frame (8), smile (1), numbers (6), minimap (1) */
+#define MINIMAP_QUAD 15
+
+/*
+ * Linked programs are cached in the user's pref dir, keyed by a hash of
+ * the driver strings and the shader sources. Anything that doesn't load
+ * (no file, other driver, unknown format) is compiled from source.
+ */
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH           0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+#define GL_PROGRAM_BINARY_FORMATS          0x87FF
+#endif
+
+#define SHADER_CACHE_MAX_FORMATS 16
+
+typedef void (APIENTRY *gl_get_program_binary_fn)(GLuint program, GLsizei bufsize, GLsizei *length,
+                                                  GLenum *format, void *binary);
+typedef void (APIENTRY *gl_program_binary_fn)(GLuint program, GLenum format, const void *binary, GLsizei length);
+typedef void (APIENTRY *gl_program_parameteri_fn)(GLuint program, GLenum pname, GLint value);
+
+struct shader_cache {
+    char *dir;                /* NULL when binaries are not supported */
+    uint64_t driver;          /* hash of vendor, renderer and version */
+    GLint nformat;
+    GLint formats[SHADER_CACHE_MAX_FORMATS];
+    gl_get_program_binary_fn get_program_binary;
+    gl_program_binary_fn program_binary;
+    gl_program_parameteri_fn program_parameteri;
+};
+
+struct shader_cache_header { char magic[4]; GLenum format; uint64_t key; };
 
 struct vertex { float x, y, tx, ty; };
+struct overview_vertex { float x, y; unsigned char r, g, b, a; };
+
+struct camera {
+    float x, y;           /* board pixel at the top left of the field view */
+    float zoom;           /* screen pixels per board pixel */
+    float minzoom;        /* zoom at which the whole board fits */
+    bool panning;         /* middle mouse drag */
+};
+
+struct minimap {
+    bool shown;           /* only when the board does not fit the view */
+    bool dragging;        /* jumping around with the mouse held down */
+    int k;                /* lod level, one texel per block */
+    int tw, th;           /* texture size in texels */
+    float x, y, w, h;     /* window rect, top left origin */
+    float u, v;           /* texcoord extent of the board, edge blocks overhang */
+    unsigned char *pixels;/* rgba, tw * th */
+    bool *dirty;          /* texel queued in dirty_list */
+    int *dirty_list;
+    int ndirty;
+    int version;          /* bumped whenever pixels change */
+};
+
+/*
+ * Immutable snapshot of what is on screen, built by the logic thread and
+ * drawn by the render thread. Only the visible cells (or overview blocks)
+ * are in it, so it is bounded by the size of the view.
+ */
+struct frame {
+    struct camera cam;
+    int w, h;                 /* board size in cells */
+    int k;                    /* 0: cells, otherwise overview level */
+    int bx0, by0, cols, rows; /* visible cells or level k blocks */
+    unsigned char *tiles;     /* tile id per cell or rgb per block, row by row */
+    int smile;
+    int counter[3], timer[3];
+    int minimap_version;
+    unsigned char *minimap;   /* rgba, copied only when the version changed */
+};
+
+/*
+ * Lock-free triple buffer. The logic thread fills the back slot and swaps
+ * it with the middle one; the render thread swaps the middle slot with its
+ * front one when it holds a newer frame. Neither side ever waits.
+ */
+#define TRIPLE_FRESH 4
+
+struct triple {
+    struct frame slot[3];
+    SDL_AtomicInt middle;     /* index of the middle slot | TRIPLE_FRESH */
+    int back;                 /* owned by the logic thread */
+    int front;                /* owned by the render thread */
+};
 
 enum {
     GAME_STATE_IDLE,
@@ -96,27 +296,127 @@ struct gamestate {
     int time;             /* game time in seconds */
     int rem;              /* remaining mines */
     int w, h;             /* width, height */
-    int hot;              /* hot tile */
+    int hx, hy;           /* hot cell */
     bool infield;         /* mouse in frame */
     bool down;            /* mouse pressed */
     bool up;              /* mouse released */
-    unsigned char *field; /* minefield */
-    bool *bombs;          /* location of mines */
+    bool flag;            /* right button pressed: flag or unflag the hot cell */
+    bool hint;            /* h pressed: play a move the numbers prove, or the best guess */
+    struct board *board;  /* mines, adjacency and metrics */
+    uint64_t *revealed;   /* 1 bit per cell, rows start on a word */
+    uint64_t *flagged;
+    int boom;             /* the mine that ended the game */
+    int safe;             /* safe cells still covered */
+    unsigned char *nflag; /* flagged neighbours of each cell, a nibble each */
+    bool *touched;        /* plane words changed this game */
+    int *touched_list;
+    int ntouched;
+    int *opened;          /* cells the last reveal uncovered, BOARD_OPEN_ROOM */
+    bool smile_down;      /* mouse pressed on the smiley */
+    bool reset;           /* smiley released, start over */
+};
+
+/*
+ * Threads started once in game_init and handed work, so spreading a job
+ * over n threads costs a semaphore post each rather than a thread spawn.
+ * The thread running a job is its thread 0 and pool threads 1 to n - 1
+ * join in, all calling fn(data, k); one job at a time.
+ */
+struct pool_seat {
+    struct pool *pool;
+    int k;
+    SDL_Semaphore *go;
+};
+struct pool {
+    int n;
+    SDL_Thread *thread[BOARD_WORKERS];
+    struct pool_seat seat[BOARD_WORKERS];
+    SDL_Semaphore *done;
+    void (*fn)(void *data, int k);
+    void *data;           /* NULL fn: the threads quit */
 };
 
 static void die(const char *fmt, ...);
-static void render(void);
+static void render(const struct frame *f);
 static void window_init(void);
+static void gl_init(void);
+static void gl_teardown(void);
 static void teardown(void);
-static void tilemap_init(int w, int h);
+static int render_main(void *data);
+static int board_worker(void *data);
+static int tilemap_worker(void *data);
+static int skin_worker(void *data);
+static void tilemap_init(int w, int h, void *lod_mem, void *minimap_mem);
+static void layout_init(int w, int h);
+static size_t arena_memsize(int w, int h, int nbomb);
+static size_t minimap_memsize(int w, int h);
+static void camera_init(int w, int h);
 static void game_init(int w, int h, int nbomb);
+static void game_reset(void);
 static void game_update(void);
+static void endless_update(void);
+static void game_start(void);
+static void next_board_start(void);
+static void next_board_wait(void);
+static int next_board_main(void *data);
+static void generate(struct board *b, uint64_t seed, struct pool *p);
+static void pool_start(struct pool *p, int n, const char *name);
+static void pool_run(struct pool *p, void (*fn)(void *data, int k), void *data);
+static void pool_stop(struct pool *p);
+static void noguess(int click);
+static void file_game_init(void);
+static void file_game_resume(void);
+static void file_generate(void);
+static void file_checkpoint(bool wait);
+static void reveal(int i);
+static void game_open(int i);
+static void game_flag(int i);
+static void game_chord(int i);
+static void game_hint(void);
+static bool smile_at(float mx, float my);
+static void row_tiles(int y, int x0, int n, unsigned char *out);
 static void quad_update_texture(struct vertex *v, int tex);
+static GLuint shader_build(const char *vs, const char *fs);
+static void shader_cache_init(void);
+static void camera_clamp(void);
+static void camera_zoom(float factor, float mx, float my);
+static bool field_cell_at(float mx, float my, int *x, int *y);
+static void frame_build(struct frame *f);
+static void frame_vertices(const struct frame *f);
+static void frame_chrome(struct frame *f);
+static void frame_build_endless(struct frame *f);
+static void triple_publish(struct triple *tb);
+static struct frame *triple_acquire(struct triple *tb);
+static int cell_class(int i);
+static void cell_set(int i, int cls);
+static void cell_note(int i, int from, int to);
+static int flags_near(int i);
+static void flag_count(int i, int d);
+static struct lod_block block_counts(int k, int bx, int by, int *area);
+static void minimap_init(int w, int h, int x0, int x1, int y0, int y1, void *mem);
+static void minimap_update(void);
+static bool minimap_jump(float mx, float my);
 
 /* GLOBAL DATA */
 int scw, sch;
+const char *skin_path;  /* atlas png to load instead of the built-in one */
+void *skin_image;
+int skin_w, skin_h;
+
+/* startup work that overlaps window and gl context creation */
+struct startup {
+    int w, h, nbomb;
+    void *lod_mem;        /* carved from the arena before the workers start */
+    void *minimap_mem;
+};
+SDL_Thread *board_thread, *tilemap_thread, *skin_thread;
+SDL_Semaphore *startup_done;  /* lets the render thread past gl setup */
+Uint64 startup_t0;            /* for time to first frame */
+int fieldx, fieldy, fieldw, fieldh; /* field view, window pixels from the top left */
 
 GLuint VAO, VBO, EBO, shader, texture, uniform_tex0;
+GLuint overview_VAO, overview_VBO, overview_shader;
+GLuint minimap_texture;
 SDL_Window *window;
 SDL_GLContext glctx;
 
@@ -127,35 +427,210 @@ GLuint *index_buffer;
 int index_buffer_size = 0;
 int index_buffer_count = 0;
 
+struct overview_vertex *overview_buffer;
+int overview_buffer_size = 0;
+int overview_quads = 0;
+
 struct vertex *mine_vertices;
+int mine_quads = 0;
 struct vertex *bomb_counter_vertices;
 struct vertex *timer_vertices;
 struct vertex *smile_vertices;
+struct vertex *minimap_vertices;
+
+/*
+ * Board and game buffers all live in one arena sized at startup. Board
+ * lifetime allocations come first; everything above game_mark belongs to
+ * the current game and is dropped by resetting to it.
+ */
+struct arena arena;
+size_t game_mark;
+
+struct pool pool;         /* the game thread's: reveals, no-guess boards, hints */
+struct pool next_pool;    /* the next board's */
+
+/*
+ * The board in play and the one being generated for the next game, on a
+ * thread of its own that waits on next_go and posts next_ready when done.
+ */
+struct board boards[2];
+struct board *next_board;
+SDL_Thread *next_thread;
+SDL_Semaphore *next_go, *next_ready;
+bool next_pending;        /* next_ready still to be waited on */
+uint64_t seed;
+
+/* generation spreads a board's chunks over threads; one board at a time */
+struct gen_job {
+    struct board *b;
+    bool count;           /* second pass: all chunks are placed */
+    SDL_AtomicInt next;   /* the next chunk to take */
+};
+struct board_scratch gen_scratch[BOARD_WORKERS];
+int nworker;              /* threads a board is generated or opened on */
+
+/* a reveal whose frontier grew large enough to be opened on nworker threads */
+struct board_flood flood;
+
+/*
+ * With --board the board and its planes live in a mapped file instead of
+ * the arena, there is no next board (a restart generates into the file)
+ * and the game carries over to the next run.
+ */
+const char *board_path;
+struct boardfile file;
+bool file_dirty;          /* changed since the last checkpoint */
+Uint64 file_synced;       /* ms */
+
+/* with --opening the first click always opens a region, not just a cell */
+bool opening_mode;
+
+/*
+ * With --noguess the board is made at the first click instead: nworker
+ * threads try numbered attempts until one clears by deduction alone. The
+ * lowest attempt that passes wins, whichever thread finds it first, so the
+ * board only depends on the seed and the click.
+ */
+struct noguess_job {
+    struct board b;       /* a candidate */
+    struct solver s;
+    int click;
+    int found;            /* the attempt b passed with, or -1 */
+};
+bool noguess_mode;
+struct noguess_job noguess_jobs[BOARD_WORKERS];
+SDL_AtomicInt noguess_next;   /* the next attempt to take */
+SDL_AtomicInt noguess_best;   /* the lowest attempt passed so far */
+uint64_t noguess_seed;
+
+/*
+ * What the revealed numbers prove, for hints; remembers solved parts of
+ * the frontier between moves. Its per cell map is only set up, in
+ * hint_mem, at the first hint.
+ */
+struct solver_frontier hint;
+void *hint_mem;
+int hint_steps;           /* each sampling chain's share of a round */
+
+/* endless mode replaces the board with chunks made on demand */
+bool endless_mode;
+double endless_density;
+struct endless endless;
 
 struct gamestate state;
+struct camera cam;
+struct lod lod;
+struct minimap minimap;
+
+struct shader_cache shader_cache;
+
+struct triple frames;
+SDL_Thread *render_thread;
+SDL_AtomicInt render_quit;
 
 int
 main(int argc, char *argv[])
 {
     bool ret, quit;
     SDL_Event e;
-    int w, h, i;
+    int w, h, nbomb;
+    struct startup job;
+
+    startup_t0 = SDL_GetPerformanceCounter();
+    seed = startup_t0;
 
     w = 9;
     h = 9;
+    nbomb = 10;
+
+    /* usage: minesweeper [--skin atlas.png] [--board file] [--opening | --noguess] [--endless [density] | width height mines] */
+    if (argc >= 3 && !strcmp(argv[1], "--skin")) {
+        skin_path = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc >= 3 && !strcmp(argv[1], "--board")) {
+        board_path = argv[2];
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc >= 2 && !strcmp(argv[1], "--opening")) {
+        opening_mode = true;
+        argc--;
+        argv++;
+    } else if (argc >= 2 && !strcmp(argv[1], "--noguess")) {
+        noguess_mode = true;
+        argc--;
+        argv++;
+    }
+    if (argc >= 2 && !strcmp(argv[1], "--endless")) {
+        /* the fixed size board machinery only ever sees one view's worth */
+        endless_mode = true;
+        endless_density = argc >= 3 ? atof(argv[2]) : 0.2;
+        if (endless_density < ENDLESS_MIN_DENSITY || endless_density >= 1)
+            die("invalid density %s, between %.2f and 1\n", argv[2], ENDLESS_MIN_DENSITY);
+        w = VIEW_MAX_W / TILE;
+        h = VIEW_MAX_H / TILE;
+    } else if (argc == 4) {
+        w = atoi(argv[1]);
+        h = atoi(argv[2]);
+        nbomb = atoi(argv[3]);
+        if (!board_fits(w, h) || nbomb < 1 || nbomb >= (long long)w * h)
+            die("invalid board: %s x %s with %s mines\n", argv[1], argv[2], argv[3]);
+    }
+    if (board_path) {
+        /* a file that already holds a board keeps its size */
+        if (endless_mode) die("--board needs a fixed size board\n");
+        if (!boardfile_open(&file, board_path, w, h, nbomb)) die("couldn't map board file %s\n", board_path);
+        w = file.hdr->w;
+        h = file.hdr->h;
+        nbomb = file.hdr->nbomb;
+    }
+
+    /*
+     * Board generation, vertex/overview setup and skin decoding run on
+     * workers while SDL brings the window up and the render thread
+     * compiles shaders. Everything joins before the first upload.
+     */
+    layout_init(w, h);
+
+    if (!arena_init(&arena, arena_memsize(w, h, nbomb))) die("couldn't allocate board memory\n");
+    job = (struct startup) { w, h, nbomb };
+    job.lod_mem = arena_alloc(&arena, lod_memsize(w, h));
+    job.minimap_mem = arena_alloc(&arena, minimap_memsize(w, h));
+    game_mark = arena.used;
+    startup_done = SDL_CreateSemaphore(0);
+    sdl_err(startup_done != NULL);
+    board_thread = SDL_CreateThread(board_worker, "board", &job);
+    tilemap_thread = SDL_CreateThread(tilemap_worker, "tilemap", &job);
+    sdl_err(board_thread && tilemap_thread);
+    if (skin_path) {
+        skin_thread = SDL_CreateThread(skin_worker, "skin", NULL);
+        sdl_err(skin_thread != NULL);
+    }
 
-    game_init(w, h, 10);
-    tilemap_init(w, h);
     window_init();
 
+    /* the render thread owns the gl context from here on */
+    render_thread = SDL_CreateThread(render_main, "render", NULL);
+    sdl_err(render_thread != NULL);
+
+    SDL_WaitThread(board_thread, NULL);
+    SDL_WaitThread(tilemap_thread, NULL);
+    if (skin_thread) SDL_WaitThread(skin_thread, NULL);
+    if (board_path) file_game_resume();
+    camera_init(w, h);
+    SDL_SignalSemaphore(startup_done);
+
     SDL_StartTextInput(window);
 
     quit = false;
     while (!quit) {
 
-        /* input */
+        /* input, waiting a little for the first event so this doesn't spin */
 
-        while (SDL_PollEvent(&e)) {
+        ret = SDL_WaitEventTimeout(&e, 10);
+        while (ret) {
 
             switch (e.type) {
             case SDL_EVENT_QUIT:
@@ -163,68 +638,123 @@ main(int argc, char *argv[])
                 break;
 
             case SDL_EVENT_MOUSE_MOTION:
-                i = (((int)e.motion.x - 10) / 16) + (((int)e.motion.y - 52) / 16) * w;
-                state.infield = (i >= 0 && i < (w * h));
+                if (cam.panning) {
+                    cam.x -= e.motion.xrel / cam.zoom;
+                    cam.y -= e.motion.yrel / cam.zoom;
+                    camera_clamp();
+                }
+                if (minimap.dragging) minimap_jump(e.motion.x, e.motion.y);
+                state.infield = field_cell_at(e.motion.x, e.motion.y, &state.hx, &state.hy);
                 break;
 
             case SDL_EVENT_MOUSE_BUTTON_DOWN:
-                i = (((int)e.motion.x - 10) / 16) + (((int)e.motion.y - 52) / 16) * w;
-                state.infield = (i >= 0 && i < (w * h));
-                state.down = (e.button.button == SDL_BUTTON_LEFT);
+                state.infield = field_cell_at(e.button.x, e.button.y, &state.hx, &state.hy);
+                if (e.button.button == SDL_BUTTON_LEFT) {
+                    state.smile_down = smile_at(e.button.x, e.button.y);
+                    minimap.dragging = minimap_jump(e.button.x, e.button.y);
+                    state.down = !minimap.dragging && !state.smile_down;
+                }
+                if (e.button.button == SDL_BUTTON_RIGHT) state.flag = true;
+                if (e.button.button == SDL_BUTTON_MIDDLE) cam.panning = true;
                 break;
 
             case SDL_EVENT_MOUSE_BUTTON_UP:
-                i = (((int)e.motion.x - 10) / 16) + (((int)e.motion.y - 52) / 16) * w;
-                state.infield = (i >= 0 && i < (w * h));
-                state.up = (e.button.button == SDL_BUTTON_LEFT);
+                state.infield = field_cell_at(e.button.x, e.button.y, &state.hx, &state.hy);
+                if (e.button.button == SDL_BUTTON_LEFT) {
+                    if (state.smile_down) state.reset = smile_at(e.button.x, e.button.y);
+                    state.up = !minimap.dragging && !state.smile_down;
+                    minimap.dragging = false;
+                    state.smile_down = false;
+                }
+                if (e.button.button == SDL_BUTTON_MIDDLE) cam.panning = false;
+                break;
+
+            case SDL_EVENT_MOUSE_WHEEL:
+                camera_zoom(powf(1.25f, e.wheel.y), e.wheel.mouse_x, e.wheel.mouse_y);
                 break;
 
             case SDL_EVENT_TEXT_INPUT:
+                if (!strcmp(e.text.text, "h")) state.hint = true;
                 break;
 
             default:
                 break;
             }
+
+            ret = SDL_PollEvent(&e);
         }
 
         game_update();
-        render();
+        minimap_update();
+        if (file_dirty && SDL_GetTicks() - file_synced >= CHECKPOINT_MS) file_checkpoint(false);
 
-        ret = SDL_GL_SwapWindow(window);
-        sdl_err(ret);
+        frame_build(&frames.slot[frames.back]);
+        triple_publish(&frames);
     }
 
     ret = SDL_StopTextInput(window);
     sdl_err(ret);
 
+    SDL_SetAtomicInt(&render_quit, 1);
+    SDL_WaitThread(render_thread, NULL);
+    next_board_wait();
+    if (next_thread) {
+        SDL_SignalSemaphore(next_go);
+        SDL_WaitThread(next_thread, NULL);
+    }
+    pool_stop(&pool);
+    pool_stop(&next_pool);
+    if (board_path) file_checkpoint(true);
+
     teardown();
 
     return 0;
 }
 
 void
-tilemap_init(int w, int h)
+tilemap_init(int w, int h, void *lod_mem, void *minimap_mem)
 {
-    int barh, border, tile, ox, oy, vcount, i, j, nquad;
+    int barh, border, vcount, i, nquad, nmine, noverview;
     struct vertex *v;
 
-    tile = 16;
-    border = 10;
-    barh = 52;
-    scw = border * 2 + tile * w;
-    sch = barh + tile * h + border;
+    /* window and field sizes come from layout_init */
+    border = fieldx;
+    barh = fieldy;
 
-    /* frame (8), smile (1), numbers (6) */
-    nquad = 8 + 1 + 6 + h * w;
+    lod_init(&lod, w, h, lod_mem);
+
+    /* minimap goes in the bar, between the bomb counter and the smile */
+    minimap_init(w, h, 62, scw / 2 - 20, 8, barh - 8, minimap_mem);
+
+    /* only the cells (or overview blocks) in view get a quad, plus the
+     * minimap view outline */
+    nmine = ((int)(fieldw / CELL_MIN_PX) + 2) * ((int)(fieldh / CELL_MIN_PX) + 2);
+    noverview = ((int)(fieldw / BLOCK_MIN_PX) + 2) * ((int)(fieldh / BLOCK_MIN_PX) + 2) + 4;
 
     /* 4 vertices per quad */
-    vcount = nquad * 4;
+    vcount = (CHROME_QUADS + nmine) * 4;
 
     vertex_buffer_size = vcount * sizeof(*vertex_buffer);
     vertex_buffer = malloc(vertex_buffer_size);
     if (!vertex_buffer) die("couldn't allocate vertex buffer");
 
-    /* 6 indices per quad */
+    overview_buffer_size = noverview * 4 * sizeof(*overview_buffer);
+    overview_buffer = malloc(overview_buffer_size);
+    if (!overview_buffer) die("couldn't allocate overview buffer");
+
+    /* frame snapshots, one tile id or rgb color per visible cell or block */
+    for (i = 0; i < 3; i++) {
+        frames.slot[i].tiles = malloc((nmine > noverview ? nmine : noverview) * 3);
+        frames.slot[i].minimap = malloc(minimap.tw * minimap.th * 4);
+        frames.slot[i].minimap_version = -1;
+        if (!frames.slot[i].tiles || !frames.slot[i].minimap) die("couldn't allocate frames");
+    }
+    frames.back = 0;
+    SDL_SetAtomicInt(&frames.middle, 1);
+    frames.front = 2;
+
+    /* 6 indices per quad, shared by both vertex buffers */
+    nquad = CHROME_QUADS + nmine > noverview ? CHROME_QUADS + nmine : noverview;
     index_buffer_count = nquad * 6;
     index_buffer_size = index_buffer_count * sizeof(*index_buffer);
     index_buffer = malloc(index_buffer_size);
@@ -351,24 +881,20 @@ tilemap_init(int w, int h)
     quad_update_texture(v, TILE_NUM_5);
     v += 4;
 
-    /* mines */
+    /* minimap, textured with its own texture */
+    minimap_vertices = v;
+    v[0] = (struct vertex) {             minimap.x,             sch - minimap.y,         0,         0 };
+    v[1] = (struct vertex) { minimap.x + minimap.w,             sch - minimap.y, minimap.u,         0 };
+    v[2] = (struct vertex) {             minimap.x, sch - minimap.y - minimap.h,         0, minimap.v };
+    v[3] = (struct vertex) { minimap.x + minimap.w, sch - minimap.y - minimap.h, minimap.u, minimap.v };
+    v += 4;
+
+    /* mines, filled in by frame_vertices */
     mine_vertices = v;
-    ox = border;
-    oy = sch - barh;
-    for (j = 0; j < h; j++) {
-        for (i = 0; i < w; i++) {
-            v[0] = (struct vertex) {       ox + i * tile,       oy - j * tile };
-            v[1] = (struct vertex) { ox + (i + 1) * tile,       oy - j * tile };
-            v[2] = (struct vertex) {       ox + i * tile, oy - (j + 1) * tile };
-            v[3] = (struct vertex) { ox + (i + 1) * tile, oy - (j + 1) * tile };
-            quad_update_texture(v, TILE_CELL_UNKNOWN);
-            v += 4;
-        }
-    }
 
     /* map vertex coordinates to gl space */
     v = vertex_buffer;
-    for (i = 0; i < vcount; i++) {
+    for (i = 0; i < CHROME_QUADS * 4; i++) {
         v[i].x = v[i].x / (float)scw * 2.0 - 1.0;
         v[i].y = v[i].y / (float)sch * 2.0 - 1.0;
     }
@@ -382,15 +908,87 @@ tilemap_init(int w, int h)
         index_buffer[i*6 + 4] = 2 + i*4;
         index_buffer[i*6 + 5] = 3 + i*4;
     }
+
+}
+
+/* arena bytes for a w x h board, everything game_init and tilemap_init carve */
+static size_t
+arena_memsize(int w, int h, int nbomb)
+{
+    size_t words = BOARD_CELLS(w, h) / 64;
+    int nplane = board_path ? 0 : 2;
+
+    /* with a board file the planes, flag counts and board are in the file */
+    return lod_memsize(w, h) + minimap_memsize(w, h)
+        + words * (nplane * sizeof(uint64_t) + sizeof(*state.touched) + sizeof(*state.touched_list))
+        + (board_path ? 0 : BOARD_CELLS(w, h) / 2)
+        + BOARD_OPEN_ROOM(w, h) * sizeof(*state.opened)
+        + (board_path ? board_work_memsize(w, h) : 2 * board_memsize(w, h, nbomb))
+        + BOARD_WORKERS * (board_scratch_memsize(w, h) + ARENA_ALIGN) + 8 * ARENA_ALIGN
+        + solver_frontier_memsize(w, h) + ARENA_ALIGN
+        + (noguess_mode ? BOARD_WORKERS * (board_memsize(w, h, nbomb) + solver_memsize(w, h) + 2 * ARENA_ALIGN) : 0);
+}
+
+/*
+ * Upper bound on the minimap buffers, before the level is picked: one
+ * texel per finest block, but never more than fit in the bar (or a single
+ * texel when even the top level doesn't).
+ */
+static size_t
+minimap_memsize(int w, int h)
+{
+    size_t n, fit;
+
+    n = (size_t)((w + (1 << LOD_MIN_LEVEL) - 1) >> LOD_MIN_LEVEL)
+      * (size_t)((h + (1 << LOD_MIN_LEVEL) - 1) >> LOD_MIN_LEVEL);
+    fit = (size_t)scw * fieldy;
+    if (n > fit) n = fit;
+    return n * (sizeof(*minimap.dirty_list) + 4 + sizeof(*minimap.dirty));
+}
+
+/* window and field view sizes, cheap enough to do before anything else */
+static void
+layout_init(int w, int h)
+{
+    int barh, border;
+
+    border = 10;
+    barh = 52;
+
+    /* the field view shows the whole board unless it gets too large */
+    fieldw = TILE * w < VIEW_MAX_W ? TILE * w : VIEW_MAX_W;
+    fieldh = TILE * h < VIEW_MAX_H ? TILE * h : VIEW_MAX_H;
+    fieldx = border;
+    fieldy = barh;
+
+    scw = border * 2 + fieldw;
+    sch = barh + fieldh + border;
+}
+
+static void
+camera_init(int w, int h)
+{
+    if (endless_mode) {
+        /* no overview without a board, so cells never get smaller than this */
+        cam.minzoom = CELL_MIN_PX / TILE;
+        cam.zoom = 1.0;
+        cam.x = -fieldw / 2.0f;
+        cam.y = -fieldh / 2.0f;
+        return;
+    }
+
+    cam.minzoom = 1.0;
+    if ((float)fieldw / (TILE * w) < cam.minzoom) cam.minzoom = (float)fieldw / (TILE * w);
+    if ((float)fieldh / (TILE * h) < cam.minzoom) cam.minzoom = (float)fieldh / (TILE * h);
+    cam.zoom = 1.0;
+    cam.x = cam.y = 0;
+    camera_clamp();
 }
 
 static void
 window_init(void)
 {
-    GLuint vertex_shader, fragment_shader;
-    int ret, w, h, ch;
-    GLenum fmt;
-    void *image;
+    int ret;
 
     /* init SDL */
 
@@ -403,6 +1001,9 @@ window_init(void)
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+#ifndef NDEBUG
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
 
     /* SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1); */
     /* SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24); */
@@ -413,34 +1014,43 @@ window_init(void)
     glctx = SDL_GL_CreateContext(window);
     sdl_err(glctx != NULL);
 
+    /* released for the render thread */
+    ret = SDL_GL_MakeCurrent(window, NULL);
+    sdl_err(ret);
+}
+
+/* runs on the render thread */
+static void
+gl_init(void)
+{
+    int ret, w, h;
+    void *image;
+
+    ret = SDL_GL_MakeCurrent(window, glctx);
+    sdl_err(ret);
+
     ret = SDL_GL_SetSwapInterval(-1);
     sdl_err(ret);
 
     gladLoadGL();
 
+#ifndef NDEBUG
+    gl_debug_init();
+#endif
+
+    shader_cache_init();
+
     /* init opengl */
 
     glViewport(0, 0, scw, sch);
 
-    /* build shader program */
+    /* build shader programs */
 
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
-    glCompileShader(vertex_shader);
-    GL_ERR("create vertex shader");
-
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
-    glCompileShader(fragment_shader);
-    GL_ERR("create fragment shader");
+    shader = shader_build(vertex_shader_source, fragment_shader_source);
+    overview_shader = shader_build(overview_vertex_shader_source, overview_fragment_shader_source);
 
-    shader = glCreateProgram();
-    glAttachShader(shader, vertex_shader);
-    glAttachShader(shader, fragment_shader);
-    glLinkProgram(shader);
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-    GL_ERR("compile shader");
+    /* buffers and textures need the startup workers */
+    SDL_WaitSemaphore(startup_done);
 
     /* VAO/VBO/EBO setup */
 
@@ -456,7 +1066,7 @@ window_init(void)
     glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size, NULL, GL_DYNAMIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size, NULL, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size, index_buffer, GL_STATIC_DRAW);
 
     /* shader attributes (layout) position and color */
 
@@ -465,6 +1075,22 @@ window_init(void)
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
 
+    /* overview blocks share the index buffer */
+
+    glGenVertexArrays(1, &overview_VAO);
+    glGenBuffers(1, &overview_VBO);
+
+    glBindVertexArray(overview_VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, overview_VBO);
+    glBufferData(GL_ARRAY_BUFFER, overview_buffer_size, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(*overview_buffer), (void *)0);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(*overview_buffer), (void *)(2 * sizeof(float)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
     /* unbind */
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
@@ -472,16 +1098,17 @@ window_init(void)
 
     GL_ERR("create VAO/VBO/EBO");
 
-    /* load texture */
+    /* load texture, the built-in atlas is already decoded */
 
-    image = stbi_load("tilemap.png", &w, &h, &ch, 0);
-    if (!image) die("stbi_load: could not load image `%s`\n", "tilemap.png");
+    image = (void *)tilemap_rgba;
+    w = TILEMAP_RGBA_W;
+    h = TILEMAP_RGBA_H;
 
-    switch (ch) {
-    case 1: fmt = GL_RED; break;
-    case 3: fmt = GL_RGB; break;
-    case 5: fmt = GL_RGBA; break;
-    default: die("unsupported channel count: %d", ch);;
+    /* decoded by skin_worker */
+    if (skin_path) {
+        image = skin_image;
+        w = skin_w;
+        h = skin_h;
     }
 
     /* texture setup */
@@ -491,7 +1118,7 @@ window_init(void)
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, fmt, w, h, 0, fmt, GL_UNSIGNED_BYTE, image);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
     glGenerateMipmap(GL_TEXTURE_2D);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -503,52 +1130,187 @@ window_init(void)
     glUseProgram(shader);
     glUniform1i(uniform_tex0, 0);
 
-    stbi_image_free(image);
+    if (skin_path) stbi_image_free(skin_image);
+
+    /* minimap texture, filled in by render from the frames */
+
+    glGenTextures(1, &minimap_texture);
+    glBindTexture(GL_TEXTURE_2D, minimap_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, minimap.tw, minimap.th, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+/* runs on the render thread */
 static void
-teardown(void)
+gl_teardown(void)
 {
     glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &overview_VAO);
     glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &overview_VBO);
     glDeleteBuffers(1, &EBO);
     glDeleteTextures(1, &texture);
+    glDeleteTextures(1, &minimap_texture);
     glDeleteProgram(shader);
+    glDeleteProgram(overview_shader);
+    SDL_free(shader_cache.dir);
 
     GL_ERR("cleanup");
 
+    SDL_GL_MakeCurrent(window, NULL);
+}
+
+static void
+teardown(void)
+{
+    int i;
+
+    SDL_DestroySemaphore(startup_done);
     SDL_DestroyWindow(window);
     SDL_Quit();
 
+    for (i = 0; i < 3; i++) {
+        free(frames.slot[i].tiles);
+        free(frames.slot[i].minimap);
+    }
     free(vertex_buffer);
+    free(overview_buffer);
     free(index_buffer);
-    free(state.field);
+    arena_free(&arena);
+    if (endless_mode) endless_free(&endless);
+    if (board_path) boardfile_close(&file);
+}
+
+static int
+board_worker(void *data)
+{
+    struct startup *job = data;
+
+    if (endless_mode) {
+        if (!endless_init(&endless, splitmix64(&seed), endless_density, ENDLESS_BUDGET))
+            die("couldn't allocate endless board\n");
+        state.w = job->w;
+        state.h = job->h;
+        return 0;
+    }
+    game_init(job->w, job->h, job->nbomb);
+    return 0;
+}
+
+static int
+tilemap_worker(void *data)
+{
+    struct startup *job = data;
+    tilemap_init(job->w, job->h, job->lod_mem, job->minimap_mem);
+    return 0;
+}
+
+static int
+skin_worker(void *data)
+{
+    int ch;
+
+    (void)data;
+    skin_image = stbi_load(skin_path, &skin_w, &skin_h, &ch, 4);
+    if (!skin_image) die("stbi_load: could not load image `%s`\n", skin_path);
+    if (skin_w != TILEMAP_RGBA_W || skin_h != TILEMAP_RGBA_H)
+        die("skin `%s` is %dx%d, expected %dx%d\n", skin_path, skin_w, skin_h, TILEMAP_RGBA_W, TILEMAP_RGBA_H);
+    return 0;
+}
+
+static int
+render_main(void *data)
+{
+    struct frame *f;
+    int ret;
+    bool first;
+
+    (void)data;
+    gl_init();
+
+    first = true;
+    while (!SDL_GetAtomicInt(&render_quit)) {
+        f = triple_acquire(&frames);
+        if (!f) {
+            SDL_Delay(1);
+            continue;
+        }
+
+        frame_vertices(f);
+        render(f);
+
+        ret = SDL_GL_SwapWindow(window);
+        sdl_err(ret);
+
+        if (first) {
+            printf("time to first frame: %.1f ms\n",
+                   (double)(SDL_GetPerformanceCounter() - startup_t0) * 1000.0 / SDL_GetPerformanceFrequency());
+            fflush(stdout);
+            first = false;
+        }
+    }
+
+    gl_teardown();
+    return 0;
 }
 
 static void
-render(void)
+render(const struct frame *f)
 {
-    /* update vbo */
+    static int minimap_version = -1;
+
+    /* update vbos, only the quads in use */
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_buffer_size, vertex_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (CHROME_QUADS + mine_quads) * 4 * sizeof(*vertex_buffer), vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, overview_VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (overview_quads + 4) * 4 * sizeof(*overview_buffer), overview_buffer);
     GL_ERR("update vbo");
 
-    /* update ebo */
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_buffer_size, index_buffer);
-    GL_ERR("update ebo");
+    /* the minimap is bar sized, upload all of it when it changed */
+    if (minimap.shown && f->minimap_version != minimap_version) {
+        glBindTexture(GL_TEXTURE_2D, minimap_texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, minimap.tw, minimap.th, GL_RGBA, GL_UNSIGNED_BYTE, f->minimap);
+        minimap_version = f->minimap_version;
+        GL_ERR("update minimap");
+    }
 
     /* clear background */
     glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
     GL_ERR("clear color");
 
-    /* draw */
+    /* draw frame */
     glUseProgram(shader);
     glBindVertexArray(VAO);
     glBindTexture(GL_TEXTURE_2D, texture);
-    glDrawElements(GL_TRIANGLES, index_buffer_count, GL_UNSIGNED_INT, NULL);
+    glDrawElements(GL_TRIANGLES, MINIMAP_QUAD * 6, GL_UNSIGNED_INT, NULL);
+
+    if (minimap.shown) {
+        glBindTexture(GL_TEXTURE_2D, minimap_texture);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void *)(MINIMAP_QUAD * 6 * sizeof(*index_buffer)));
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    /* draw field, clipped to the field view */
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(fieldx, sch - fieldy - fieldh, fieldw, fieldh);
+    glDrawElements(GL_TRIANGLES, mine_quads * 6, GL_UNSIGNED_INT,
+                   (void *)(CHROME_QUADS * 6 * sizeof(*index_buffer)));
+
+    glUseProgram(overview_shader);
+    glBindVertexArray(overview_VAO);
+    if (overview_quads)
+        glDrawElements(GL_TRIANGLES, overview_quads * 6, GL_UNSIGNED_INT, NULL);
+    glDisable(GL_SCISSOR_TEST);
+
+    /* outline of the field view on the minimap */
+    if (minimap.shown)
+        glDrawElements(GL_TRIANGLES, 4 * 6, GL_UNSIGNED_INT, (void *)(overview_quads * 6 * sizeof(*index_buffer)));
     GL_ERR("draw elements");
 
     /* unbind buffers */
@@ -557,6 +1319,10 @@ render(void)
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
     GL_ERR("unbind buffers");
+
+#ifndef NDEBUG
+    if (gl_debug_error) die("gl error reported by debug output\n");
+#endif
 }
 
 static void
@@ -572,81 +1338,1376 @@ die(const char *fmt, ...)
 static void
 game_init(int w, int h, int nbomb)
 {
+    size_t words;
+    void *b0, *b1, *p, *q;
     int i;
-    state.state = GAME_STATE_IDLE;
-    state.time = 0;
-    state.rem = nbomb;
+
     state.w = w;
     state.h = h;
-    state.hot = 0;
-    state.down = false;
-    state.field = malloc(sizeof(*state.field) * w * h);
-    state.bombs = malloc(sizeof(*state.bombs) * w * h);
-    if (!state.field || !state.bombs) die("malloc failed\n");
-    memset(state.field, TILE_CELL_UNKNOWN, sizeof(*state.field) * w * h);
-    memset(state.bombs, TILE_CELL_UNKNOWN, sizeof(*state.bombs) * w * h);
-    do {
-        i = (randf() * (w * h - 1));
-        if (state.bombs[i]) {
-            state.bombs[i] = true;
-            nbomb--;
-        }
-    } while (nbomb);
+    words = BOARD_CELLS(w, h) / 64;
+
+    /*
+     * Carved once; game_reset reuses all of it. The opened list and the
+     * hint's frontier are sized for the worst case, and the touched flags
+     * come zeroed from the arena, so only the pages a fill or a hint
+     * actually reaches are ever faulted in.
+     */
+    arena_reset(&arena, game_mark);
+    if (board_path) {
+        state.revealed = file.revealed;
+        state.flagged = file.flagged;
+        state.nflag = file.nflag;
+    } else {
+        state.revealed = arena_zalloc(&arena, sizeof(*state.revealed) * words);
+        state.flagged = arena_zalloc(&arena, sizeof(*state.flagged) * words);
+        state.nflag = arena_zalloc(&arena, BOARD_CELLS(w, h) / 2);
+    }
+    state.touched = arena_zalloc(&arena, sizeof(*state.touched) * words);
+    state.touched_list = arena_alloc(&arena, sizeof(*state.touched_list) * words);
+    state.opened = arena_alloc(&arena, sizeof(*state.opened) * BOARD_OPEN_ROOM(w, h));
+    nworker = SDL_GetNumLogicalCPUCores();
+    if (nworker < 1) nworker = 1;
+    if (nworker > BOARD_WORKERS) nworker = BOARD_WORKERS;
+    if (!pool.n) pool_start(&pool, nworker, "worker");
+    for (i = 0; i < nworker; i++) {
+        p = arena_alloc(&arena, board_scratch_memsize(w, h));
+        if (!p) die("board arena too small\n");
+        board_scratch_init(&gen_scratch[i], w, h, p);
+    }
+    for (i = 0; noguess_mode && i < nworker; i++) {
+        p = arena_alloc(&arena, board_memsize(w, h, nbomb));
+        q = arena_alloc(&arena, solver_memsize(w, h));
+        if (!p || !q) die("board arena too small\n");
+        board_init(&noguess_jobs[i].b, w, h, nbomb, p);
+        solver_init(&noguess_jobs[i].s, w, h, q);
+        noguess_jobs[i].s.best = &noguess_best.value;
+    }
+    hint_mem = arena_alloc(&arena, solver_frontier_memsize(w, h));
+    hint.slot = NULL;
+    b0 = arena_alloc(&arena, board_path ? board_work_memsize(w, h) : board_memsize(w, h, nbomb));
+    b1 = board_path ? b0 : arena_alloc(&arena, board_memsize(w, h, nbomb));
+    if (!state.revealed || !state.flagged || !state.touched || !state.touched_list || !state.opened || !state.nflag
+        || !hint_mem || !b0 || !b1)
+        die("board arena too small\n");
+    state.ntouched = 0;
+
+    if (board_path) {
+        board_init_work(&boards[0], w, h, nbomb, b0);
+        state.board = &boards[0];
+        file_game_init();
+        return;
+    }
+
+    board_init(&boards[0], w, h, nbomb, b0);
+    board_init(&boards[1], w, h, nbomb, b1);
+    state.board = &boards[0];
+    next_board = &boards[1];
+    generate(state.board, splitmix64(&seed), &pool);
+    if (!next_thread) {
+        pool_start(&next_pool, nworker, "next board");
+        next_go = SDL_CreateSemaphore(0);
+        next_ready = SDL_CreateSemaphore(0);
+        sdl_err(next_go && next_ready);
+        next_thread = SDL_CreateThread(next_board_main, "next board", NULL);
+        sdl_err(next_thread != NULL);
+    }
+    next_board_start();
+
+    game_start();
 }
 
+/*
+ * New game on the same buffers. Only the plane words the last game
+ * changed are set back, through cell_set so the overview and minimap
+ * follow, so the cost is what the last game touched rather than the
+ * board size. The next board was generated in the background while this
+ * one was played, so it is swapped in rather than built.
+ */
 static void
-game_update(void)
+game_reset(void)
 {
-    int i;
+    struct board *b;
+    uint64_t bits;
+    int r, w;
+
+    for (r = 0; r < state.ntouched; r++) {
+        w = state.touched_list[r];
+        for (bits = state.revealed[w] | state.flagged[w]; bits; bits &= bits - 1)
+            cell_set(w * 64 + __builtin_ctzll(bits), LOD_UNKNOWN);
+        state.touched[w] = false;
+    }
+    state.ntouched = 0;
 
-    /* TODO(luke) continue writing game logic */
+    if (board_path) {
+        file_generate();
+        return;
+    }
 
-    if (state.up) {
-        state.up = false;
-        state.down = false;
+    /* only blocks if the reset comes before the worker is done */
+    next_board_wait();
+    b = state.board;
+    state.board = next_board;
+    next_board = b;
+    next_board_start();
+
+    game_start();
+}
+
+static void
+game_start(void)
+{
+    state.state = GAME_STATE_IDLE;
+    state.time = 0;
+    state.rem = state.board->nbomb;
+    state.safe = state.w * state.h - state.board->nbomb;
+}
+
+static int
+pool_main(void *data)
+{
+    struct pool_seat *seat = data;
+    struct pool *p = seat->pool;
+
+    for (;;) {
+        SDL_WaitSemaphore(seat->go);
+        if (!p->fn) return 0;
+        p->fn(p->data, seat->k);
+        SDL_SignalSemaphore(p->done);
     }
+}
 
-    if (state.down) {
-        if (state.infield) {
-            quad_update_texture(mine_vertices + state.hot * 4, TILE_CELL_EMPTY);
-        }
+/* n threads for p's jobs, the one running a job counted */
+static void
+pool_start(struct pool *p, int n, const char *name)
+{
+    int k;
+
+    p->n = n;
+    p->done = SDL_CreateSemaphore(0);
+    sdl_err(p->done != NULL);
+    for (k = 1; k < n; k++) {
+        p->seat[k] = (struct pool_seat) { p, k, SDL_CreateSemaphore(0) };
+        sdl_err(p->seat[k].go != NULL);
+        p->thread[k] = SDL_CreateThread(pool_main, name, &p->seat[k]);
+        sdl_err(p->thread[k] != NULL);
     }
+}
+
+/* fn(data, k) for k from 0 to p->n - 1, 0 on the calling thread; returns when all are done */
+static void
+pool_run(struct pool *p, void (*fn)(void *data, int k), void *data)
+{
+    int k;
+
+    p->fn = fn;
+    p->data = data;
+    for (k = 1; k < p->n; k++)
+        SDL_SignalSemaphore(p->seat[k].go);
+    fn(data, 0);
+    for (k = 1; k < p->n; k++)
+        SDL_WaitSemaphore(p->done);
+}
 
-    for (i = 0; i < state.w * state.h; i++) {
-        quad_update_texture(mine_vertices + i * 4, state.field[i]);
+static void
+pool_stop(struct pool *p)
+{
+    int k;
+
+    p->fn = NULL;
+    for (k = 1; k < p->n; k++) {
+        SDL_SignalSemaphore(p->seat[k].go);
+        SDL_WaitThread(p->thread[k], NULL);
+        SDL_DestroySemaphore(p->seat[k].go);
     }
+    if (p->n) SDL_DestroySemaphore(p->done);
+    p->n = 0;
+}
 
-    if (state.infield && state.up) {
-        state.up = false;
+static int
+next_board_main(void *data)
+{
+    (void)data;
+    for (;;) {
+        SDL_WaitSemaphore(next_go);
+        if (!next_pending) return 0;
+        generate(next_board, next_board->seed, &next_pool);
+        SDL_SignalSemaphore(next_ready);
+    }
+}
 
-        if (state.bombs[state.hot]) {
-            state.state = GAME_STATE_LOST;
-            state.field[state.hot] = TILE_CELL_BOMB;
-        }
+static void
+gen_worker(void *data, int k)
+{
+    struct gen_job *job = data;
+    int c;
+
+    while ((c = SDL_AddAtomicInt(&job->next, 1)) < job->b->nchunk) {
+        if (job->count)
+            board_count(job->b, c);
+        else
+            board_place(job->b, c, &gen_scratch[k]);
+    }
+}
+
+/*
+ * board_generate with the chunks shared out between p's threads, the
+ * calling one included. Which thread gets which chunk doesn't change the
+ * board. The game's pool and the next board's never generate at once, so
+ * they share gen_scratch.
+ */
+static void
+generate(struct board *b, uint64_t seed, struct pool *p)
+{
+    struct gen_job job;
+    int pass;
+
+    board_split(b, seed);
+    for (pass = 0; pass < 2; pass++) {
+        job.b = b;
+        job.count = pass == 1;
+        SDL_SetAtomicInt(&job.next, 0);
+        pool_run(p, gen_worker, &job);
+    }
+    board_finish(b);
+}
+
+/* build the board after this one while the player is busy */
+static void
+next_board_start(void)
+{
+    next_board->seed = splitmix64(&seed);
+    next_pending = true;
+    SDL_SignalSemaphore(next_go);
+}
 
-        quad_update_texture(mine_vertices + state.hot * 4, TILE_CELL_EMPTY);
+/* until the next board is built, if it is being built */
+static void
+next_board_wait(void)
+{
+    if (!next_pending) return;
+    SDL_WaitSemaphore(next_ready);
+    next_pending = false;
+}
 
-        state.field[state.hot] = TILE_CELL_EMPTY;
+static void
+noguess_worker(void *data, int k)
+{
+    struct noguess_job *job = &noguess_jobs[k];
+    int a, best;
+
+    (void)data;
+
+    job->found = -1;
+    while ((a = SDL_AddAtomicInt(&noguess_next, 1)) < NOGUESS_ATTEMPTS && a < SDL_GetAtomicInt(&noguess_best)) {
+        job->s.attempt = a;
+        if (!solver_noguess(&job->s, &job->b, splitmix64_at(noguess_seed, a), job->click)) continue;
+        job->found = a;
+        /* any later attempt this thread passed would lose to a */
+        do
+            best = SDL_GetAtomicInt(&noguess_best);
+        while (a < best && !SDL_CompareAndSwapAtomicInt(&noguess_best, best, a));
+        break;
     }
+}
+
+/*
+ * Replace the board in play with one the player can clear from click
+ * without guessing, made from its seed. If no attempt passes the board is
+ * kept with just the first click cleared.
+ */
+static void
+noguess(int click)
+{
+    int i;
 
-    quad_update_texture(smile_vertices, TILE_SMILE_HAPPY);
+    noguess_seed = state.board->seed;
+    SDL_SetAtomicInt(&noguess_next, 0);
+    SDL_SetAtomicInt(&noguess_best, NOGUESS_ATTEMPTS);
+    for (i = 0; i < nworker; i++)
+        noguess_jobs[i].click = click;
+    pool_run(&pool, noguess_worker, NULL);
+
+    for (i = 0; i < nworker; i++) {
+        if (noguess_jobs[i].found == SDL_GetAtomicInt(&noguess_best)) {
+            board_copy(state.board, &noguess_jobs[i].b);
+            return;
+        }
+    }
+    board_clear(state.board, click, true);
+}
 
-    quad_update_texture(bomb_counter_vertices + 0, TILE_NUM_0);
-    quad_update_texture(bomb_counter_vertices + 4, TILE_NUM_0);
-    quad_update_texture(bomb_counter_vertices + 8, TILE_NUM_0);
+/*
+ * Pick up the game in the board file, or start one there when it has no
+ * board yet. The planes are as they were left; the safe count is rebuilt
+ * from them here and the rest by file_game_resume.
+ */
+static void
+file_game_init(void)
+{
+    boardfile_attach(&file, state.board);
+    if (file.fresh) {
+        file_generate();
+        return;
+    }
 
-    quad_update_texture(timer_vertices + 0, TILE_NUM_0);
-    quad_update_texture(timer_vertices + 4, TILE_NUM_0);
-    quad_update_texture(timer_vertices + 8, TILE_NUM_0);
+    game_start();
+    state.safe = board_covered_safe(state.board, state.revealed);
+    state.state = file.hdr->state;
+    state.boom = file.hdr->boom;
+    file_synced = SDL_GetTicks();
 }
 
+/*
+ * The overview, the touched list and the mine count for the planes
+ * file_game_init found; the flag counts are kept in the file. This writes the overview and minimap,
+ * so it runs once tilemap_init is done with them rather than on the board
+ * worker.
+ */
 static void
-quad_update_texture(struct vertex *v, int tex)
+file_game_resume(void)
 {
-    struct tilecoords tc;
+    size_t words, k;
+    uint64_t bits;
+    int i;
+
+    words = BOARD_CELLS(state.w, state.h) / 64;
+    for (k = 0; k < words; k++) {
+        for (bits = state.revealed[k] | state.flagged[k]; bits; bits &= bits - 1) {
+            i = k * 64 + __builtin_ctzll(bits);
+            cell_note(i, LOD_UNKNOWN, cell_class(i));
+            if (cell_class(i) == LOD_FLAGGED) state.rem--;
+        }
+    }
+}
+
+/* a new board in the file, synchronously: there is nowhere to build it aside */
+static void
+file_generate(void)
+{
+    boardfile_generating(&file);
+    generate(state.board, splitmix64(&seed), &pool);
+    boardfile_store(&file, state.board);
+    game_start();
+    file_checkpoint(true);
+}
+
+/* write the game back to the board file, waiting for the disk if asked */
+static void
+file_checkpoint(bool wait)
+{
+    file.hdr->state = state.state;
+    file.hdr->boom = state.boom;
+    boardfile_sync(&file, wait);
+    file_dirty = false;
+    file_synced = SDL_GetTicks();
+}
+
+static void
+open_worker(void *data, int k)
+{
+    board_open_work(data, k);
+}
+
+/*
+ * Uncover a safe cell, opening the empty region around it. The fill
+ * starts here and is handed to all nworker threads if it turns out big.
+ */
+static void
+reveal(int i)
+{
+    int n, j;
+
+    if (board_open_start(&flood, state.board, i, state.revealed, state.flagged, state.opened, nworker))
+        pool_run(&pool, open_worker, &flood);
+    n = board_open_end(&flood);
+    for (j = 0; j < n; j++)
+        cell_note(state.opened[j], LOD_UNKNOWN, LOD_REVEALED);
+    state.safe -= n;
+
+#ifndef NDEBUG
+    /* the running count, which decides the win, against the plane */
+    if (state.safe != board_covered_safe(state.board, state.revealed))
+        die("%d safe cells covered, the revealed plane says %d\n",
+            state.safe, board_covered_safe(state.board, state.revealed));
+#endif
+}
+
+/*
+ * The game just ended: say how hard the board was. A first click that
+ * moved mines left its counts stale, so they are made again here, over
+ * the whole board but once a game.
+ */
+static void
+game_over(void)
+{
+    struct board *b = state.board;
+
+    if (b->bbbv < 0) {
+        board_label(b);
+        if (board_path) boardfile_store(&file, b);
+    }
+    printf("%s: 3BV %d, %d openings\n", state.state == GAME_STATE_WON ? "won" : "lost", b->bbbv, b->nopening);
+    fflush(stdout);
+}
+
+/*
+ * Left click on a covered cell. The first reveal of a game can't hit a
+ * mine: the board was made ahead of time, so the mines in the way are
+ * moved off, which is as good as placing them now and takes no time.
+ * With --noguess the board is made over from the click instead.
+ */
+static void
+game_open(int i)
+{
+    if (state.safe == state.w * state.h - state.board->nbomb) {
+        if (noguess_mode)
+            noguess(i);
+        else
+            board_clear(state.board, i, opening_mode);
+        if (board_path && (noguess_mode || state.board->nmoved)) boardfile_store(&file, state.board);
+    }
+    state.state = GAME_STATE_ONGOING;
+    if (board_cell(state.board, i) == BOARD_MINE) {
+        /* the rest of the mines are drawn from state.state, flags left as they are */
+        state.state = GAME_STATE_LOST;
+        state.boom = i;
+        cell_set(i, LOD_REVEALED);
+        game_over();
+        return;
+    }
+    reveal(i);
+    if (!state.safe) {
+        state.state = GAME_STATE_WON;
+        game_over();
+    }
+}
+
+/* right click: flag a covered cell, or take its flag off */
+static void
+game_flag(int i)
+{
+    int cls = cell_class(i);
+
+    if (cls == LOD_REVEALED) return;
+    cell_set(i, cls == LOD_FLAGGED ? LOD_UNKNOWN : LOD_FLAGGED);
+    state.rem += cls == LOD_FLAGGED ? 1 : -1;
+}
+
+/*
+ * Left click on a number with as many flags around it: open the covered
+ * cells around it. The flag counts make the check O(1); a wrong flag
+ * loses the game on the mine it left covered.
+ */
+static void
+game_chord(int i)
+{
+    int n = board_cell(state.board, i), x, y, dx, dy, nx, ny, j;
+
+    if (!n || n == BOARD_MINE || flags_near(i) != n) return;
+    board_xy(state.board, i, &x, &y);
+    for (dy = -1; dy <= 1; dy++) {
+        for (dx = -1; dx <= 1; dx++) {
+            nx = x + dx;
+            ny = y + dy;
+            if (nx < 0 || ny < 0 || nx >= state.w || ny >= state.h) continue;
+            j = board_index(state.board, nx, ny);
+            if (state.state <= GAME_STATE_ONGOING && cell_class(j) == LOD_UNKNOWN) game_open(j);
+        }
+    }
+}
+
+static void
+hint_worker(void *data, int k)
+{
+    (void)data;
+    for (; k < hint.nchain; k += nworker)
+        solver_sample_work(&hint, k, hint_steps);
+}
+
+/*
+ * Sample the parts of the frontier too big to count on all nworker
+ * threads, a chain or more each, in rounds that double while the next
+ * still ends within HINT_MS, until the estimates are within HINT_ERROR.
+ */
+static void
+hint_sample(void)
+{
+    Uint64 deadline, start, now;
+    double err;
+
+    if (!solver_sample_start(&hint, nworker, splitmix64_at(state.board->seed, state.safe))) return;
+    deadline = SDL_GetTicks() + HINT_MS;
+    hint_steps = HINT_STEPS;
+    do {
+        start = SDL_GetTicks();
+        pool_run(&pool, hint_worker, NULL);
+        err = solver_sample_end(&hint);
+        now = SDL_GetTicks();
+        if (now + 2 * (now - start) < deadline) hint_steps *= 2;
+    } while (err > HINT_ERROR && now < deadline);
+}
+
+/*
+ * h: open a cell the revealed numbers prove safe, or else flag one they
+ * prove is a mine. When nothing is certain, open the covered cell least
+ * likely to be one: the likeliest of the frontier, or any covered cell
+ * away from it when the density is lower.
+ */
+static void
+game_hint(void)
+{
+    size_t words, w;
+    uint64_t bits;
+    int k, i, x, y, guess;
+    double best;
+
+    if (!hint.slot) solver_frontier_init(&hint, state.w, state.h, hint_mem);
+    solver_analyse(&hint, state.board, state.revealed, state.board->nbomb);
+    for (k = 0; k < hint.nfront; k++) {
+        i = hint.front[k];
+        if (hint.prob[k] == 0 && cell_class(i) == LOD_UNKNOWN) {
+            game_open(i);
+            return;
+        }
+    }
+    for (k = 0; k < hint.nfront; k++) {
+        i = hint.front[k];
+        if (hint.prob[k] == 1 && cell_class(i) == LOD_UNKNOWN) {
+            game_flag(i);
+            return;
+        }
+    }
+
+    hint_sample();
+    guess = -1;
+    best = 2;
+    for (k = 0; k < hint.nfront; k++) {
+        if (hint.prob[k] >= best || cell_class(hint.front[k]) != LOD_UNKNOWN) continue;
+        best = hint.prob[k];
+        guess = hint.front[k];
+    }
+
+    /* the first covered cell no number touches, usually a few words in */
+    words = BOARD_CELLS(state.w, state.h) / 64;
+    for (w = 0; hint.density < best && w < words; w++) {
+        for (bits = ~(state.revealed[w] | state.flagged[w]); bits; bits &= bits - 1) {
+            i = w * 64 + __builtin_ctzll(bits);
+            board_xy(state.board, i, &x, &y);
+            if (x >= state.w || y >= state.h || hint.slot[i]) continue;
+            guess = i;
+            best = hint.density;
+            break;
+        }
+    }
+    if (guess >= 0) game_open(guess);
+}
+
+static void
+game_update(void)
+{
+    int hot, cls;
+
+    /* the pressed cell is drawn by frame_build */
+
+    if (endless_mode) {
+        endless_update();
+        return;
+    }
+
+    if (state.reset) {
+        game_reset();
+        state.reset = false;
+    }
+
+    hot = board_index(state.board, state.hx, state.hy);
+    if ((state.hint || (state.infield && (state.up || state.flag))) && state.state <= GAME_STATE_ONGOING) {
+        cls = state.hint ? -1 : cell_class(hot);
+        if (state.hint)
+            game_hint();
+        else if (state.flag)
+            game_flag(hot);
+        else if (cls == LOD_UNKNOWN)
+            game_open(hot);
+        else if (cls == LOD_REVEALED)
+            game_chord(hot);
+
+        /* a finished game goes to disk right away, one in play now and then */
+        if (board_path) {
+            file_dirty = true;
+            if (state.state >= GAME_STATE_WON) file_checkpoint(true);
+        }
+    }
+
+    if (state.up) {
+        state.up = false;
+        state.down = false;
+    }
+    state.flag = false;
+    state.hint = false;
+}
+
+/* game_update for endless mode: no board to win, cascades spread over frames */
+static void
+endless_update(void)
+{
+    if (state.reset) {
+        endless_reset(&endless, splitmix64(&seed));
+        state.state = GAME_STATE_IDLE;
+        state.reset = false;
+    }
+
+    if (state.infield && state.flag && state.state <= GAME_STATE_ONGOING)
+        endless_flag(&endless, state.hx, state.hy);
+    if (state.infield && state.up && state.state <= GAME_STATE_ONGOING
+        && !endless_state(&endless, state.hx, state.hy)) {
+        state.state = GAME_STATE_ONGOING;
+        if (endless_open(&endless, state.hx, state.hy)) state.state = GAME_STATE_LOST;
+    }
+    endless_step(&endless, ENDLESS_STEP);
+
+    if (state.up) {
+        state.up = false;
+        state.down = false;
+    }
+    state.flag = false;
+    state.hint = false;
+}
+
+static void
+quad_update_texture(struct vertex *v, int tex)
+{
+    struct tilecoords tc;
     tc = tilemap_get_tilecoords(tex);
     v[0].tx = (float)tc.x0 / 256.0; v[0].ty = (float)tc.y0 / 256.0;
     v[1].tx = (float)tc.x1 / 256.0; v[1].ty = (float)tc.y1 / 256.0;
     v[2].tx = (float)tc.x2 / 256.0; v[2].ty = (float)tc.y2 / 256.0;
     v[3].tx = (float)tc.x3 / 256.0; v[3].ty = (float)tc.y3 / 256.0;
 }
+
+static uint64_t
+fnv1a(uint64_t h, const char *s)
+{
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static void
+shader_cache_init(void)
+{
+    const char *str[3];
+    GLint n;
+    int i;
+
+    if (!SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) return;
+
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n);
+    if (n < 1 || n > SHADER_CACHE_MAX_FORMATS) return;
+    shader_cache.nformat = n;
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, shader_cache.formats);
+
+    shader_cache.get_program_binary = (gl_get_program_binary_fn)SDL_GL_GetProcAddress("glGetProgramBinary");
+    shader_cache.program_binary = (gl_program_binary_fn)SDL_GL_GetProcAddress("glProgramBinary");
+    shader_cache.program_parameteri = (gl_program_parameteri_fn)SDL_GL_GetProcAddress("glProgramParameteri");
+    if (!shader_cache.get_program_binary || !shader_cache.program_binary || !shader_cache.program_parameteri)
+        return;
+
+    str[0] = (const char *)glGetString(GL_VENDOR);
+    str[1] = (const char *)glGetString(GL_RENDERER);
+    str[2] = (const char *)glGetString(GL_VERSION);
+    shader_cache.driver = 0xcbf29ce484222325ull;
+    for (i = 0; i < 3; i++)
+        shader_cache.driver = fnv1a(fnv1a(shader_cache.driver, str[i] ? str[i] : ""), "\n");
+
+    shader_cache.dir = SDL_GetPrefPath("minesweeper", "minesweeper");
+}
+
+static void
+shader_cache_path(char *path, size_t size, uint64_t key)
+{
+    snprintf(path, size, "%sshader-%016llx.bin", shader_cache.dir, (unsigned long long)key);
+}
+
+static GLuint
+shader_cache_load(uint64_t key)
+{
+    struct shader_cache_header hdr;
+    unsigned char *data;
+    char path[1024];
+    size_t size;
+    GLuint program;
+    GLint ok;
+    int i;
+
+    shader_cache_path(path, sizeof(path), key);
+    data = SDL_LoadFile(path, &size);
+    if (!data) return 0;
+
+    program = 0;
+    if (size <= sizeof(hdr)) goto out;
+    memcpy(&hdr, data, sizeof(hdr));
+    if (memcmp(hdr.magic, "MSPB", 4) || hdr.key != key) goto out;
+
+    /* a format the driver no longer lists would be a gl error */
+    for (i = 0; i < shader_cache.nformat; i++)
+        if ((GLenum)shader_cache.formats[i] == hdr.format) break;
+    if (i == shader_cache.nformat) goto out;
+
+    program = glCreateProgram();
+    shader_cache.program_binary(program, hdr.format, data + sizeof(hdr), size - sizeof(hdr));
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+
+out:
+    SDL_free(data);
+    return program;
+}
+
+/* best effort, a failed write just means compiling again next time */
+static void
+shader_cache_save(GLuint program, uint64_t key)
+{
+    struct shader_cache_header hdr;
+    unsigned char *data;
+    char path[1024];
+    GLsizei len;
+    GLint size;
+
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) return;
+
+    data = malloc(sizeof(hdr) + size);
+    if (!data) return;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "MSPB", 4);
+    hdr.key = key;
+    shader_cache.get_program_binary(program, size, &len, &hdr.format, data + sizeof(hdr));
+    memcpy(data, &hdr, sizeof(hdr));
+
+    shader_cache_path(path, sizeof(path), key);
+    SDL_SaveFile(path, data, sizeof(hdr) + len);
+    free(data);
+}
+
+static GLuint
+shader_build(const char *vs, const char *fs)
+{
+    GLuint vertex_shader, fragment_shader, program;
+    uint64_t key;
+
+    key = 0;
+    if (shader_cache.dir) {
+        key = fnv1a(fnv1a(shader_cache.driver, vs), fs);
+        program = shader_cache_load(key);
+        if (program) return program;
+    }
+
+    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex_shader, 1, &vs, NULL);
+    glCompileShader(vertex_shader);
+    GL_ERR("create vertex shader");
+
+    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &fs, NULL);
+    glCompileShader(fragment_shader);
+    GL_ERR("create fragment shader");
+
+    program = glCreateProgram();
+    if (shader_cache.dir)
+        shader_cache.program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    GL_ERR("compile shader");
+
+    if (shader_cache.dir) shader_cache_save(program, key);
+
+    return program;
+}
+
+static void
+camera_clamp(void)
+{
+    float bw, bh, vw, vh;
+
+    if (cam.zoom < cam.minzoom) cam.zoom = cam.minzoom;
+    if (cam.zoom > ZOOM_MAX) cam.zoom = ZOOM_MAX;
+    if (endless_mode) return;
+
+    bw = (float)state.w * TILE;
+    bh = (float)state.h * TILE;
+    vw = fieldw / cam.zoom;
+    vh = fieldh / cam.zoom;
+
+    /* center the board when it is smaller than the view */
+    if (bw <= vw) cam.x = (bw - vw) / 2;
+    else if (cam.x < 0) cam.x = 0;
+    else if (cam.x > bw - vw) cam.x = bw - vw;
+
+    if (bh <= vh) cam.y = (bh - vh) / 2;
+    else if (cam.y < 0) cam.y = 0;
+    else if (cam.y > bh - vh) cam.y = bh - vh;
+}
+
+/* zoom by factor, keeping the board point under (mx, my) in place */
+static void
+camera_zoom(float factor, float mx, float my)
+{
+    float bx, by;
+
+    bx = cam.x + (mx - fieldx) / cam.zoom;
+    by = cam.y + (my - fieldy) / cam.zoom;
+    cam.zoom *= factor;
+    camera_clamp();
+    cam.x = bx - (mx - fieldx) / cam.zoom;
+    cam.y = by - (my - fieldy) / cam.zoom;
+    camera_clamp();
+}
+
+/* board cell under window position (mx, my) in *x, *y, false outside the board */
+static bool
+field_cell_at(float mx, float my, int *x, int *y)
+{
+    float bx, by;
+    int cx, cy;
+
+    if (mx < fieldx || my < fieldy || mx >= fieldx + fieldw || my >= fieldy + fieldh)
+        return false;
+
+    bx = cam.x + (mx - fieldx) / cam.zoom;
+    by = cam.y + (my - fieldy) / cam.zoom;
+    cx = (int)floorf(bx / TILE);
+    cy = (int)floorf(by / TILE);
+    if (!endless_mode && (cx < 0 || cy < 0 || cx >= state.w || cy >= state.h)) return false;
+
+    *x = cx;
+    *y = cy;
+    return true;
+}
+
+/* the smiley, in window coordinates (top left origin) */
+static bool
+smile_at(float mx, float my)
+{
+    return mx >= scw / 2 - 13 && mx < scw / 2 + 13
+        && my >= fieldy / 2 - 13 && my < fieldy / 2 + 13;
+}
+
+/* screen rect (top left origin) to gl space */
+static void
+quad_set_rect(struct vertex *v, float x0, float y0, float x1, float y1)
+{
+    x0 = x0 / (float)scw * 2.0 - 1.0; x1 = x1 / (float)scw * 2.0 - 1.0;
+    y0 = 1.0 - y0 / (float)sch * 2.0; y1 = 1.0 - y1 / (float)sch * 2.0;
+    v[0].x = x0; v[0].y = y0;
+    v[1].x = x1; v[1].y = y0;
+    v[2].x = x0; v[2].y = y1;
+    v[3].x = x1; v[3].y = y1;
+}
+
+static void
+overview_quad(struct overview_vertex *o, float x0, float y0, float x1, float y1, const unsigned char *c)
+{
+    int i;
+    x0 = x0 / (float)scw * 2.0 - 1.0; x1 = x1 / (float)scw * 2.0 - 1.0;
+    y0 = 1.0 - y0 / (float)sch * 2.0; y1 = 1.0 - y1 / (float)sch * 2.0;
+    o[0].x = x0; o[0].y = y0;
+    o[1].x = x1; o[1].y = y0;
+    o[2].x = x0; o[2].y = y1;
+    o[3].x = x1; o[3].y = y1;
+    for (i = 0; i < 4; i++) {
+        o[i].r = c[0]; o[i].g = c[1]; o[i].b = c[2]; o[i].a = 255;
+    }
+}
+
+/* blend of unknown, revealed and flagged colors by their share of the block */
+static void
+overview_color(struct lod_block b, int area, unsigned char *c)
+{
+    static const float unknown[3]  = { 128, 128, 128 };
+    static const float revealed[3] = { 198, 198, 198 };
+    static const float flagged[3]  = { 220,  30,  30 };
+    float fr, ff, fu;
+    int i;
+
+    fr = (float)b.revealed / area;
+    ff = (float)b.flagged / area;
+    fu = 1.0 - fr - ff;
+    for (i = 0; i < 3; i++)
+        c[i] = unknown[i] * fu + revealed[i] * fr + flagged[i] * ff;
+}
+
+/*
+ * Snapshot what is in view for the render thread. Close up that is the
+ * tile of every visible cell; zoomed out it is the color of every visible
+ * overview block, so the cost is bounded by the size of the view, not the
+ * board.
+ */
+static void
+frame_build(struct frame *f)
+{
+    float cellpx;
+    int k, bsize, bx1, by1, bx, by, i, area, hx, hy;
+    unsigned char *t;
+    struct lod_block b;
+
+    if (endless_mode) {
+        frame_build_endless(f);
+        return;
+    }
+
+    cellpx = TILE * cam.zoom;
+    if (cellpx >= CELL_MIN_PX) {
+        k = 0;
+    } else {
+        k = lod_pick_level(&lod, cellpx, BLOCK_MIN_PX);
+    }
+
+    /* visible range in cells (k = 0) or level k blocks */
+    bsize = TILE << k;
+    f->cam = cam;
+    f->w = state.w;
+    f->h = state.h;
+    f->k = k;
+    f->bx0 = cam.x > 0 ? (int)(cam.x / bsize) : 0;
+    f->by0 = cam.y > 0 ? (int)(cam.y / bsize) : 0;
+    bx1 = (int)ceilf((cam.x + fieldw / cam.zoom) / bsize);
+    by1 = (int)ceilf((cam.y + fieldh / cam.zoom) / bsize);
+    if (bx1 > (state.w + (1 << k) - 1) >> k) bx1 = (state.w + (1 << k) - 1) >> k;
+    if (by1 > (state.h + (1 << k) - 1) >> k) by1 = (state.h + (1 << k) - 1) >> k;
+    f->cols = bx1 > f->bx0 ? bx1 - f->bx0 : 0;
+    f->rows = by1 > f->by0 ? by1 - f->by0 : 0;
+
+    hx = state.hx;
+    hy = state.hy;
+    t = f->tiles;
+    for (by = f->by0; by < by1; by++) {
+        if (k == 0) {
+            row_tiles(by, f->bx0, f->cols, t);
+            i = hx - f->bx0;
+            if (state.down && state.infield && hy == by && i >= 0 && i < f->cols
+                && t[i] == TILE_CELL_UNKNOWN && state.state <= GAME_STATE_ONGOING)
+                t[i] = TILE_CELL_EMPTY;
+            t += f->cols;
+            continue;
+        }
+        for (bx = f->bx0; bx < bx1; bx++) {
+            b = block_counts(k, bx, by, &area);
+            overview_color(b, area, t);
+            t += 3;
+        }
+    }
+
+    frame_chrome(f);
+
+    if (f->minimap_version != minimap.version) {
+        memcpy(f->minimap, minimap.pixels, minimap.tw * minimap.th * 4);
+        f->minimap_version = minimap.version;
+    }
+}
+
+/* smile and digits, the same in either mode */
+static void
+frame_chrome(struct frame *f)
+{
+    int i;
+
+    if (state.smile_down)
+        f->smile = TILE_SMILE_PRESSED;
+    else if (state.state == GAME_STATE_LOST)
+        f->smile = TILE_SMILE_DEAD;
+    else if (state.state == GAME_STATE_WON)
+        f->smile = TILE_SMILE_COOL;
+    else if (state.down && state.infield)
+        f->smile = TILE_SMILE_SCARED;
+    else
+        f->smile = TILE_SMILE_HAPPY;
+    for (i = 0; i < 3; i++) {
+        f->counter[i] = TILE_NUM_0;
+        f->timer[i] = TILE_NUM_0;
+    }
+}
+
+/*
+ * frame_build for endless mode: always cells, looked up a row at a time
+ * from the chunks in view, which builds the ones not seen before.
+ */
+static void
+frame_build_endless(struct frame *f)
+{
+    static const unsigned char num[16] = {
+        TILE_CELL_EMPTY, TILE_CELL_1, TILE_CELL_2, TILE_CELL_3, TILE_CELL_4,
+        TILE_CELL_5, TILE_CELL_6, TILE_CELL_7, TILE_CELL_8,
+        [BOARD_MINE] = TILE_CELL_BOMB,
+    };
+    static unsigned char st[VIEW_MAX_W / (int)CELL_MIN_PX + 2];
+    unsigned char *t;
+    int by, j, x1, y1;
+    bool lost;
+
+    f->cam = cam;
+    f->w = state.w;
+    f->h = state.h;
+    f->k = 0;
+    f->bx0 = (int)floorf(cam.x / TILE);
+    f->by0 = (int)floorf(cam.y / TILE);
+    x1 = (int)ceilf((cam.x + fieldw / cam.zoom) / TILE);
+    y1 = (int)ceilf((cam.y + fieldh / cam.zoom) / TILE);
+    f->cols = x1 - f->bx0;
+    f->rows = y1 - f->by0;
+
+    lost = state.state == GAME_STATE_LOST;
+    t = f->tiles;
+    for (by = f->by0; by < y1; by++) {
+        endless_row(&endless, by, f->bx0, f->cols, t, st);
+        for (j = 0; j < f->cols; j++) {
+            if (st[j] & ENDLESS_FLAGGED)
+                t[j] = lost && t[j] != BOARD_MINE ? TILE_CELL_BOMBX : TILE_CELL_FLAG;
+            else if (st[j] & ENDLESS_REVEALED)
+                t[j] = t[j] == BOARD_MINE && by == endless.boomy && f->bx0 + j == endless.boomx
+                     ? TILE_CELL_BOMBRED : num[t[j]];
+            else if (lost && t[j] == BOARD_MINE)
+                t[j] = TILE_CELL_BOMB;
+            else if (state.down && state.infield && !lost && by == state.hy && f->bx0 + j == state.hx)
+                t[j] = TILE_CELL_EMPTY;
+            else
+                t[j] = TILE_CELL_UNKNOWN;
+        }
+        t += f->cols;
+    }
+
+    frame_chrome(f);
+}
+
+/* quads for a frame, on the render thread */
+static void
+frame_vertices(const struct frame *f)
+{
+    const struct camera *c;
+    const unsigned char *t;
+    struct vertex *v;
+    struct overview_vertex *o;
+    float bpx, x0, y0;
+    int bsize, bx, by, cx1, cy1, i;
+
+    quad_update_texture(smile_vertices, f->smile);
+    for (i = 0; i < 3; i++) {
+        quad_update_texture(bomb_counter_vertices + i * 4, f->counter[i]);
+        quad_update_texture(timer_vertices + i * 4, f->timer[i]);
+    }
+
+    c = &f->cam;
+    bsize = TILE << f->k;
+    bpx = bsize * c->zoom;
+    mine_quads = 0;
+    overview_quads = 0;
+
+    t = f->tiles;
+    v = mine_vertices;
+    o = overview_buffer;
+    for (by = f->by0; by < f->by0 + f->rows; by++) {
+        y0 = fieldy + (by * bsize - c->y) * c->zoom;
+        for (bx = f->bx0; bx < f->bx0 + f->cols; bx++) {
+            x0 = fieldx + (bx * bsize - c->x) * c->zoom;
+
+            if (f->k == 0) {
+                quad_set_rect(v, x0, y0, x0 + bpx, y0 + bpx);
+                quad_update_texture(v, *t++);
+                v += 4;
+                mine_quads++;
+            } else {
+                /* blocks on the right and bottom edge are cut by the board */
+                cx1 = (bx + 1) << f->k; if (cx1 > f->w) cx1 = f->w;
+                cy1 = (by + 1) << f->k; if (cy1 > f->h) cy1 = f->h;
+                overview_quad(o, x0, y0,
+                              fieldx + ((float)cx1 * TILE - c->x) * c->zoom,
+                              fieldy + ((float)cy1 * TILE - c->y) * c->zoom, t);
+                t += 3;
+                o += 4;
+                overview_quads++;
+            }
+        }
+    }
+
+    /* field view outline on the minimap, drawn after the overview blocks */
+    if (minimap.shown) {
+        static const unsigned char white[3] = { 255, 255, 255 };
+        float sx, sy, mx0, my0, mx1, my1;
+
+        sx = minimap.w / ((float)f->w * TILE);
+        sy = minimap.h / ((float)f->h * TILE);
+        mx0 = minimap.x + c->x * sx;
+        my0 = minimap.y + c->y * sy;
+        mx1 = mx0 + fieldw / c->zoom * sx;
+        my1 = my0 + fieldh / c->zoom * sy;
+        if (mx0 < minimap.x) mx0 = minimap.x;
+        if (my0 < minimap.y) my0 = minimap.y;
+        if (mx1 > minimap.x + minimap.w) mx1 = minimap.x + minimap.w;
+        if (my1 > minimap.y + minimap.h) my1 = minimap.y + minimap.h;
+
+        overview_quad(o +  0, mx0,     my0,     mx1,     my0 + 1, white);
+        overview_quad(o +  4, mx0,     my1 - 1, mx1,     my1,     white);
+        overview_quad(o +  8, mx0,     my0,     mx0 + 1, my1,     white);
+        overview_quad(o + 12, mx1 - 1, my0,     mx1,     my1,     white);
+    }
+}
+
+/* logic thread: hand the back slot over and take the stale middle one */
+static void
+triple_publish(struct triple *tb)
+{
+    SDL_MemoryBarrierRelease();
+    tb->back = SDL_SetAtomicInt(&tb->middle, tb->back | TRIPLE_FRESH) & 3;
+}
+
+/* render thread: the newest frame, or NULL if nothing new was published */
+static struct frame *
+triple_acquire(struct triple *tb)
+{
+    if (!(SDL_GetAtomicInt(&tb->middle) & TRIPLE_FRESH)) return NULL;
+    tb->front = SDL_SetAtomicInt(&tb->middle, tb->front) & 3;
+    SDL_MemoryBarrierAcquire();
+    return &tb->slot[tb->front];
+}
+
+static int
+cell_class(int i)
+{
+    uint64_t bit = 1ull << (i & 63);
+    if (state.flagged[i >> 6] & bit) return LOD_FLAGGED;
+    if (state.revealed[i >> 6] & bit) return LOD_REVEALED;
+    return LOD_UNKNOWN;
+}
+
+/* every change to the planes goes through here */
+static void
+cell_set(int i, int cls)
+{
+    uint64_t bit = 1ull << (i & 63);
+    int from;
+
+    from = cell_class(i);
+    if (from == cls) return;
+
+    state.revealed[i >> 6] &= ~bit;
+    state.flagged[i >> 6] &= ~bit;
+    if (cls == LOD_REVEALED) state.revealed[i >> 6] |= bit;
+    if (cls == LOD_FLAGGED) state.flagged[i >> 6] |= bit;
+    if (from == LOD_FLAGGED) flag_count(i, -1);
+    if (cls == LOD_FLAGGED) flag_count(i, 1);
+    cell_note(i, from, cls);
+}
+
+static int
+flags_near(int i)
+{
+    return state.nflag[i >> 1] >> ((i & 1) << 2) & 0xF;
+}
+
+/* add d to the flag count of each of i's neighbours */
+static void
+flag_count(int i, int d)
+{
+    int x, y, dx, dy, nx, ny, j;
+
+    board_xy(state.board, i, &x, &y);
+    for (dy = -1; dy <= 1; dy++) {
+        for (dx = -1; dx <= 1; dx++) {
+            nx = x + dx;
+            ny = y + dy;
+            if ((!dx && !dy) || nx < 0 || ny < 0 || nx >= state.w || ny >= state.h) continue;
+            j = board_index(state.board, nx, ny);
+            state.nflag[j >> 1] += (j & 1) ? d * 16 : d;
+        }
+    }
+}
+
+/* keep the overview, minimap and touched list current after a change */
+static void
+cell_note(int i, int from, int to)
+{
+    int x, y, t;
+
+    board_xy(state.board, i, &x, &y);
+    lod_update(&lod, x, y, from, to);
+
+    /* remember the word so game_reset can find it again */
+    if (to != LOD_UNKNOWN && !state.touched[i >> 6]) {
+        state.touched[i >> 6] = true;
+        state.touched_list[state.ntouched++] = i >> 6;
+    }
+
+    /* queue the minimap texel for this cell's block */
+    t = (y >> minimap.k) * minimap.tw + (x >> minimap.k);
+    if (!minimap.dirty[t]) {
+        minimap.dirty[t] = true;
+        minimap.dirty_list[minimap.ndirty++] = t;
+    }
+}
+
+/*
+ * Tiles for n cells of row y from x0 on. The adjacency nibbles are
+ * unpacked a row at a time and the plane words read once per 64 cells.
+ */
+static void
+row_tiles(int y, int x0, int n, unsigned char *out)
+{
+    static const unsigned char num[16] = {
+        TILE_CELL_EMPTY, TILE_CELL_1, TILE_CELL_2, TILE_CELL_3, TILE_CELL_4,
+        TILE_CELL_5, TILE_CELL_6, TILE_CELL_7, TILE_CELL_8,
+        [BOARD_MINE] = TILE_CELL_BOMB,
+    };
+    uint64_t rv, fl;
+    int i, j, c, w;
+
+    board_row(state.board, y, x0, n, out);
+
+    /* a word is 64 cells of the row, or 8 of a tile row when tiled */
+    w = -1;
+    rv = fl = 0;
+    for (j = 0; j < n; j++) {
+        i = board_index(state.board, x0 + j, y);
+        if (i >> 6 != w) {
+            w = i >> 6;
+            rv = state.revealed[w];
+            fl = state.flagged[w];
+        }
+        c = out[j];
+        if (fl >> (i & 63) & 1)
+            out[j] = state.state == GAME_STATE_LOST && c != BOARD_MINE ? TILE_CELL_BOMBX : TILE_CELL_FLAG;
+        else if (!(rv >> (i & 63) & 1))
+            out[j] = state.state == GAME_STATE_LOST && c == BOARD_MINE ? TILE_CELL_BOMB : TILE_CELL_UNKNOWN;
+        else if (c == BOARD_MINE && i == state.boom)
+            out[j] = TILE_CELL_BOMBRED;
+        else
+            out[j] = num[c];
+    }
+}
+
+/*
+ * Revealed and flagged counts of block (bx, by) of level k. Stored levels
+ * come from the pyramid; finer blocks are at most 8 cells wide, so each
+ * of their rows is a masked popcount of a single plane word, and when
+ * tiled all of them are in the same word.
+ */
+static struct lod_block
+block_counts(int k, int bx, int by, int *area)
+{
+    struct lod_block b = { 0, 0 };
+    uint64_t mask;
+    int s, x0, y0, y1, y, i;
+
+    if (k >= LOD_BASE_LEVEL) return lod_get(&lod, k, bx, by, area);
+
+    s = 1 << k;
+    x0 = bx << k;
+    y0 = by << k;
+    y1 = y0 + s < state.h ? y0 + s : state.h;
+    *area = ((x0 + s < state.w ? x0 + s : state.w) - x0) * (y1 - y0);
+
+    /* cells past the edges are never set, so they count for nothing */
+#ifdef BOARD_TILED
+    (void)y;
+    i = board_index(state.board, x0, y0);
+    mask = (((1ull << s) - 1) * 0x0101010101010101ull >> (64 - 8 * s)) << (i & 63);
+    b.revealed = __builtin_popcountll(state.revealed[i >> 6] & mask);
+    b.flagged = __builtin_popcountll(state.flagged[i >> 6] & mask);
+#else
+    mask = ((1ull << s) - 1) << (x0 & 63);
+    for (y = y0; y < y1; y++) {
+        i = board_index(state.board, x0, y) >> 6;
+        b.revealed += __builtin_popcountll(state.revealed[i] & mask);
+        b.flagged += __builtin_popcountll(state.flagged[i] & mask);
+    }
+#endif
+    return b;
+}
+
+/*
+ * Lay the minimap out in the window rect x0..x1, y0..y1 (top left origin).
+ * Each texel is one block of the overview pyramid, picked so the whole
+ * board fits the rect.
+ */
+static void
+minimap_init(int w, int h, int x0, int x1, int y0, int y1, void *mem)
+{
+    float s;
+    int n, i;
+    unsigned char c[3];
+
+    minimap.shown = !endless_mode && (TILE * w > fieldw || TILE * h > fieldh) && x1 - x0 >= 24;
+
+    for (minimap.k = LOD_MIN_LEVEL; minimap.k < lod.top; minimap.k++)
+        if ((w + (1 << minimap.k) - 1) >> minimap.k <= x1 - x0
+            && (h + (1 << minimap.k) - 1) >> minimap.k <= y1 - y0) break;
+    minimap.tw = (w + (1 << minimap.k) - 1) >> minimap.k;
+    minimap.th = (h + (1 << minimap.k) - 1) >> minimap.k;
+
+    /* keep the board aspect, centered in the rect */
+    s = (float)(x1 - x0) / minimap.tw;
+    if ((float)(y1 - y0) / minimap.th < s) s = (float)(y1 - y0) / minimap.th;
+    minimap.w = s * w / (1 << minimap.k);
+    minimap.h = s * h / (1 << minimap.k);
+    minimap.u = (float)w / (minimap.tw << minimap.k);
+    minimap.v = (float)h / (minimap.th << minimap.k);
+    minimap.x = x0 + ((x1 - x0) - minimap.w) / 2;
+    minimap.y = y0 + ((y1 - y0) - minimap.h) / 2;
+
+    /* minimap_memsize bytes: the dirty list, then pixels, then the flags */
+    n = minimap.tw * minimap.th;
+    minimap.dirty_list = mem;
+    minimap.pixels = (unsigned char *)(minimap.dirty_list + n);
+    minimap.dirty = (bool *)(minimap.pixels + n * 4);
+    memset(minimap.dirty, 0, n * sizeof(*minimap.dirty));
+    minimap.ndirty = 0;
+
+    overview_color((struct lod_block) { 0, 0 }, 1, c);
+    for (i = 0; i < n; i++) {
+        minimap.pixels[i*4 + 0] = c[0];
+        minimap.pixels[i*4 + 1] = c[1];
+        minimap.pixels[i*4 + 2] = c[2];
+        minimap.pixels[i*4 + 3] = 255;
+    }
+}
+
+/* recolor the texels whose blocks changed this frame, never the whole map */
+static void
+minimap_update(void)
+{
+    struct lod_block b;
+    int i, t, tx, ty, area;
+
+    for (i = 0; i < minimap.ndirty; i++) {
+        t = minimap.dirty_list[i];
+        minimap.dirty[t] = false;
+        tx = t % minimap.tw;
+        ty = t / minimap.tw;
+
+        b = block_counts(minimap.k, tx, ty, &area);
+        overview_color(b, area, minimap.pixels + t * 4);
+    }
+    if (minimap.ndirty) minimap.version++;
+    minimap.ndirty = 0;
+}
+
+/* center the field view on the board point under (mx, my), if on the map */
+static bool
+minimap_jump(float mx, float my)
+{
+    if (!minimap.shown) return false;
+    if (mx < minimap.x || my < minimap.y || mx >= minimap.x + minimap.w || my >= minimap.y + minimap.h)
+        return minimap.dragging;
+
+    cam.x = (mx - minimap.x) / minimap.w * state.w * TILE - fieldw / cam.zoom / 2;
+    cam.y = (my - minimap.y) / minimap.h * state.h * TILE - fieldh / cam.zoom / 2;
+    camera_clamp();
+    return true;
+}
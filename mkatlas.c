@@ -0,0 +1,51 @@
+/*
+ * mkatlas: decode the tile atlas at build time into a raw rgba array, so
+ * the game starts without inflating a png or touching the filesystem.
+ *
+ *     mkatlas tilemap.png tilemap_rgba.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+int
+main(int argc, char *argv[])
+{
+    unsigned char *image;
+    int w, h, ch, i, n;
+    FILE *out;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s atlas.png out.h\n", argv[0]);
+        return 1;
+    }
+
+    image = stbi_load(argv[1], &w, &h, &ch, 4);
+    if (!image) {
+        fprintf(stderr, "stbi_load: could not load image `%s`\n", argv[1]);
+        return 1;
+    }
+
+    out = fopen(argv[2], "w");
+    if (!out) {
+        fprintf(stderr, "could not open `%s`\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "/* generated by mkatlas from %s, do not edit */\n\n", argv[1]);
+    fprintf(out, "#define TILEMAP_RGBA_W %d\n", w);
+    fprintf(out, "#define TILEMAP_RGBA_H %d\n\n", h);
+    fprintf(out, "static const unsigned char tilemap_rgba[%d] = {\n", w * h * 4);
+
+    n = w * h * 4;
+    for (i = 0; i < n; i++)
+        fprintf(out, "%s0x%02x,%s", i % 16 ? " " : "    ", image[i], i % 16 == 15 || i == n - 1 ? "\n" : "");
+
+    fprintf(out, "};\n");
+
+    stbi_image_free(image);
+    return fclose(out) != 0;
+}
@@ -0,0 +1,41 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+ * splitmix64, a small generator every board can be reproduced from given
+ * one 64 bit seed. splitmix64_at is its counter based form: any number of
+ * the stream without the ones before it, so whether a cell is a mine can
+ * be a pure function of (seed, cell) and needs no state carried from the
+ * cells before it.
+ */
+
+static inline uint64_t
+splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* the nth number splitmix64 would give from seed, seed left alone */
+static inline uint64_t
+splitmix64_at(uint64_t seed, uint64_t n)
+{
+    uint64_t z = seed + (n + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* numbers below this come up with probability p */
+static inline uint64_t
+splitmix64_threshold(double p)
+{
+    if (p <= 0) return 0;
+    return p >= 1 ? UINT64_MAX : (uint64_t)(p * 18446744073709551616.0);
+}
+
+#endif
@@ -0,0 +1,1795 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+
+/*
+ * Plays a board by deduction alone, the way a careful player would. A
+ * number with all its mines found clears the rest of its neighbours, one
+ * with as many covered neighbours as mines left has them all mined, and
+ * two numbers close enough to share covered cells are reasoned about
+ * together. The board is only read for the number under a cell once the
+ * solver opens it, so what it finds a player could have too.
+ *
+ * What the solver knows is a byte per cell at its board index. Numbers
+ * whose covered neighbours changed are kept in a work list, so a run
+ * costs what changes rather than a sweep of the board.
+ *
+ * solver_noguess() builds on it: boards that can be cleared this way
+ * from the first click.
+ */
+
+enum { SOLVER_COVERED, SOLVER_OPEN, SOLVER_MINE };
+
+#define SOLVER_QUEUED 0x80      /* in the work list */
+#define SOLVER_REPAIRS 256      /* mines solver_noguess moves before giving a board up */
+
+struct solver {
+    struct board *b;
+    unsigned char *known;       /* SOLVER_COVERED, _OPEN or _MINE, | SOLVER_QUEUED */
+    int *work, nwork;           /* open numbers to look at again */
+    int *stack;                 /* cells to open */
+    int *list;                  /* covered cells, for repairs */
+    int unknown;                /* covered cells not known to be mines */
+    int mines;                  /* mines not found yet */
+    const int *best;            /* solver_noguess gives up once *best < attempt */
+    int attempt;
+};
+
+/*
+ * What a position says about the covered cells: the covered neighbours of
+ * the numbers shown (the frontier) are split into components that share
+ * no number, each solved on its own. Each number is an equation over its
+ * covered cells; row reducing them settles most cells outright, and the
+ * cells left, split again where settled cells cut them apart, have their
+ * mine layouts enumerated, counted apart by how many mines they hold.
+ * A component's answer only depends on its cells and numbers, so it is
+ * remembered by a hash of them and a move elsewhere doesn't redo it.
+ * Flags are the player's guesses, not facts, and are left out.
+ *
+ * The parts aren't independent: they share the board's mine count with
+ * each other and with the covered cells away from any number, which take
+ * whatever the parts leave, in choose(free cells, mines left) ways. That
+ * weighs each part's layouts by the mines they hold, summed over every
+ * combination of the other parts' counts, a convolution of the parts'
+ * tallies done by halves, in doubles scaled down as they go.
+ *
+ * Cells beyond SOLVER_FRONTIER are left unsolved and counted with the
+ * free cells. A part whose search runs past SOLVER_BUDGET steps, or whose
+ * tallies wouldn't fit to begin with, has its chances estimated by
+ * sampling instead, from the first layout the search found or, failing
+ * that, one a local search put together: Markov chains of its layouts
+ * that redraw a few neighbouring cells at a time from every layout of
+ * them that fits. Only a part neither finds a layout for is left
+ * unsolved. The chains are independent and each is a call of its own,
+ * so the caller can put one on each core and decide how long they run;
+ * how far apart their estimates are bounds the error.
+ */
+
+#define SOLVER_FRONTIER (1 << 17)   /* frontier cells taken on */
+#define SOLVER_BUDGET (1 << 20)     /* search steps per component */
+#define SOLVER_CACHE 1024           /* components remembered */
+#define SOLVER_POOL (1 << 16)       /* doubles of their answers, at least */
+#define SOLVER_DIST (1 << 18)       /* doubles of layout tallies being worked with, at least */
+#define SOLVER_MATRIX (1 << 19)     /* words of equations; larger components are reduced a window at a time */
+#define SOLVER_WINDOW 8             /* ... of 2x2 blocks this size */
+#define SOLVER_UNSET (-2.0)         /* prob of a cell not settled yet */
+#define SOLVER_SEEN (-3.0)          /* ... already in a part */
+#define SOLVER_PART (-4.0)          /* ... searched, its chance still to be weighed */
+#define SOLVER_SAMPLE (-5.0)        /* ... to be sampled, less its mine in the layout found */
+#define SOLVER_CHAINS BOARD_WORKERS /* sampling chains at most */
+#define SOLVER_BLOCK 20             /* cells a chain redraws together */
+#define SOLVER_BURN 1               /* sweeps a chain makes before counting */
+#define SOLVER_TINY 1e-300          /* weights dropped, next to the largest */
+
+struct solver_cached {
+    uint64_t key;
+    int n;                      /* cells */
+    int lap;                    /* as of pool lap */
+    size_t at, len;             /* its record at pool[at] */
+};
+
+/* a searched part's tallies in dist */
+struct solver_dist {
+    size_t at;                  /* layouts by mine count, then per cell its frontier index and theirs */
+    int m;                      /* cells */
+    int kmin, nk;               /* mine counts kmin .. kmin + nk - 1 */
+};
+
+struct solver_chain {
+    uint64_t rng;
+    signed char *val;           /* its layout, by sample index */
+    unsigned char *inblock;
+    double *hits;               /* counted visits with a mine, by sample index */
+    int *visits;                /* ... and visits counted */
+    int at, passes;             /* the next cell to redraw around, and the sweeps over them all made */
+    int mines;                  /* in its layout */
+    int nblock, block[SOLVER_BLOCK];    /* sample indices being redrawn */
+    int nccon[SOLVER_BLOCK], ccon[SOLVER_BLOCK][8];     /* the numbers around each, in num */
+    int nnum, num[8 * SOLVER_BLOCK], need[8 * SOLVER_BLOCK], open[8 * SOLVER_BLOCK];
+};
+
+struct solver_frontier {
+    const struct board *b;
+    const uint64_t *revealed;
+    int *slot;                  /* per cell: 1 + frontier index, -1 - number index, or 0 */
+    int nfront, *front;         /* frontier cells, a component at a time */
+    double *prob;               /* their chance of a mine, by frontier index; -1 unsolved */
+    int ncon, *con;             /* numbers with covered neighbours */
+    int *need, *open;           /* a number's mines and cells not yet placed */
+    int *pos, *order;           /* frontier index to its place in order, and back: components in a row */
+    int *part;                  /* frontier indices of the unsettled part being searched */
+    int *row, *rhs;             /* number to its equation, or -1, and the equations' right hand sides */
+    int *col;                   /* frontier index to its column, or -1 */
+    int *blk;                   /* a large component's cells by window block */
+    uint64_t *mat;              /* settled mines, settled safe cells, then the equations, as bitsets */
+    int *ccon;                  /* numbers around each cell of a component, 8 each */
+    unsigned char *nccon;
+    signed char *val;           /* the search's guess per cell; after it, the sampled cells' first layout */
+    double *dist;               /* component records, then room to combine them */
+    size_t ndist, top;
+    struct solver_dist *parts;  /* the searched parts of this position */
+    int nparts;
+    double *pool;
+    struct solver_cached cache[SOLVER_CACHE];
+    size_t npool, at;
+    int lap;
+    int nsample, *sample;       /* cells of parts too big to count, by frontier index */
+    double *weight;             /* the log of the rest of the board's weight of them holding k mines between them */
+    int heavy;                  /* the k weighed most */
+    int *place;                 /* frontier index to sample index, or -1 */
+    struct solver_chain chain[SOLVER_CHAINS];
+    int nchain;
+    double nfree, expect;       /* covered cells no number settles or weighs, sampled ones too, and their mines */
+    double error;               /* the largest standard error of a sampled chance */
+    int cap, capcon;
+    double density;             /* the chance of a mine anywhere else covered */
+};
+
+size_t solver_memsize(int w, int h);
+void solver_init(struct solver *s, int w, int h, void *mem);
+void solver_start(struct solver *s, struct board *b);
+void solver_open(struct solver *s, int i);
+bool solver_run(struct solver *s);
+bool solver_noguess(struct solver *s, struct board *b, uint64_t seed, int click);
+size_t solver_frontier_memsize(int w, int h);
+void solver_frontier_init(struct solver_frontier *f, int w, int h, void *mem);
+void solver_analyse(struct solver_frontier *f, const struct board *b, const uint64_t *revealed, int mines);
+bool solver_sample_start(struct solver_frontier *f, int nchain, uint64_t seed);
+void solver_sample_work(struct solver_frontier *f, int k, int steps);
+double solver_sample_end(struct solver_frontier *f);
+double solver_prob(const struct solver_frontier *f, int i);
+
+#endif
+
+#ifdef SOLVER_IMPLEMENTATION
+
+#include <math.h>
+#include <string.h>
+
+#define SOLVER_ALIGN(n) (((n) + 63) & ~(size_t)63)
+#define SOLVER_NPOOL(cap) (4 * (size_t)(cap) > SOLVER_POOL ? 4 * (size_t)(cap) : SOLVER_POOL)
+#define SOLVER_NDIST(cap) (8 * (size_t)(cap) > SOLVER_DIST ? 8 * (size_t)(cap) : SOLVER_DIST)
+#define SOLVER_BLOCKS(w, h) ((size_t)((w) / SOLVER_WINDOW + 2) * ((h) / SOLVER_WINDOW + 2) + 1)
+
+size_t
+solver_memsize(int w, int h)
+{
+    size_t n = BOARD_CELLS(w, h);
+
+    return SOLVER_ALIGN(n) + 3 * SOLVER_ALIGN(n * sizeof(int));
+}
+
+void
+solver_init(struct solver *s, int w, int h, void *mem)
+{
+    unsigned char *p = mem;
+    size_t n = BOARD_CELLS(w, h);
+
+    s->known = p;               p += SOLVER_ALIGN(n);
+    s->work = (int *)p;         p += SOLVER_ALIGN(n * sizeof(int));
+    s->stack = (int *)p;        p += SOLVER_ALIGN(n * sizeof(int));
+    s->list = (int *)p;
+    s->best = NULL;
+    s->attempt = 0;
+}
+
+/* nothing known of b yet */
+void
+solver_start(struct solver *s, struct board *b)
+{
+    s->b = b;
+    memset(s->known, SOLVER_COVERED, BOARD_CELLS(b->w, b->h));
+    s->nwork = 0;
+    s->unknown = b->w * b->h;
+    s->mines = b->nbomb;
+}
+
+static int
+solver_around(const struct board *b, int i, int *out)
+{
+    int x, y, dx, dy, nx, ny, n;
+
+    board_xy(b, i, &x, &y);
+    n = 0;
+    for (dy = -1; dy <= 1; dy++) {
+        for (dx = -1; dx <= 1; dx++) {
+            nx = x + dx;
+            ny = y + dy;
+            if ((dx || dy) && nx >= 0 && ny >= 0 && nx < b->w && ny < b->h)
+                out[n++] = board_index(b, nx, ny);
+        }
+    }
+    return n;
+}
+
+static void
+solver_queue(struct solver *s, int i)
+{
+    if ((s->known[i] & ~SOLVER_QUEUED) != SOLVER_OPEN || s->known[i] & SOLVER_QUEUED) return;
+    if (!board_cell(s->b, i)) return;
+    s->known[i] |= SOLVER_QUEUED;
+    s->work[s->nwork++] = i;
+}
+
+/* the numbers around i have fewer unknown neighbours */
+static void
+solver_touch(struct solver *s, int i)
+{
+    int around[8], n, k;
+
+    n = solver_around(s->b, i, around);
+    for (k = 0; k < n; k++)
+        solver_queue(s, around[k]);
+}
+
+/* open i as a player would, and the empty region behind it */
+void
+solver_open(struct solver *s, int i)
+{
+    int around[8], n, k, sp, j;
+
+    if ((s->known[i] & ~SOLVER_QUEUED) != SOLVER_COVERED) return;
+    sp = 0;
+    s->stack[sp++] = i;
+    while (sp) {
+        j = s->stack[--sp];
+        if ((s->known[j] & ~SOLVER_QUEUED) != SOLVER_COVERED) continue;
+        s->known[j] = SOLVER_OPEN;
+        s->unknown--;
+        solver_touch(s, j);
+        if (board_cell(s->b, j)) {
+            solver_queue(s, j);
+            continue;
+        }
+        n = solver_around(s->b, j, around);
+        for (k = 0; k < n; k++)
+            if ((s->known[around[k]] & ~SOLVER_QUEUED) == SOLVER_COVERED) s->stack[sp++] = around[k];
+    }
+}
+
+static void
+solver_mark(struct solver *s, int i)
+{
+    if ((s->known[i] & ~SOLVER_QUEUED) != SOLVER_COVERED) return;
+    s->known[i] = SOLVER_MINE;
+    s->unknown--;
+    s->mines--;
+    solver_touch(s, i);
+}
+
+/*
+ * The covered unknown neighbours of open number (x, y), as bits of the
+ * 7x7 window around (cx, cy), and how many of them are mines.
+ */
+static uint64_t
+solver_mask(const struct solver *s, int x, int y, int cx, int cy, int *mines)
+{
+    const struct board *b = s->b;
+    uint64_t m = 0;
+    int dx, dy, nx, ny, k;
+
+    *mines = board_cell(b, board_index(b, x, y));
+    for (dy = -1; dy <= 1; dy++) {
+        for (dx = -1; dx <= 1; dx++) {
+            nx = x + dx;
+            ny = y + dy;
+            if ((!dx && !dy) || nx < 0 || ny < 0 || nx >= b->w || ny >= b->h) continue;
+            k = s->known[board_index(b, nx, ny)] & ~SOLVER_QUEUED;
+            if (k == SOLVER_MINE) --*mines;
+            if (k == SOLVER_COVERED) m |= 1ull << ((ny - cy + 3) * 7 + nx - cx + 3);
+        }
+    }
+    return m;
+}
+
+/* open, or mark, the cells of window mask m around (cx, cy) */
+static void
+solver_apply(struct solver *s, uint64_t m, int cx, int cy, bool mine)
+{
+    int k;
+
+    for (; m; m &= m - 1) {
+        k = __builtin_ctzll(m);
+        k = board_index(s->b, cx + k % 7 - 3, cy + k / 7 - 3);
+        if (mine)
+            solver_mark(s, k);
+        else
+            solver_open(s, k);
+    }
+}
+
+/*
+ * What number i says on its own, then with each open number within two
+ * cells. For a pair, the mines in their shared cells I are between
+ * lo = max(0, r - |A|, rd - |B|) and hi = min(|I|, r, rd), A and B being
+ * the cells only one of them sees. When the rest of a number's mines
+ * fill its own cells or none are left for them, those cells are settled.
+ */
+static void
+solver_step(struct solver *s, int i)
+{
+    const struct board *b = s->b;
+    uint64_t u, ud, in, a, bb;
+    int x, y, dx, dy, nx, ny, r, rd, na, nb, ni, lo, hi;
+
+    s->known[i] &= ~SOLVER_QUEUED;
+    board_xy(b, i, &x, &y);
+    u = solver_mask(s, x, y, x, y, &r);
+    if (!u) return;
+    if (!r || r == __builtin_popcountll(u)) {
+        solver_apply(s, u, x, y, r > 0);
+        return;
+    }
+
+    for (dy = -2; dy <= 2; dy++) {
+        for (dx = -2; dx <= 2; dx++) {
+            nx = x + dx;
+            ny = y + dy;
+            if ((!dx && !dy) || nx < 0 || ny < 0 || nx >= b->w || ny >= b->h) continue;
+            if ((s->known[board_index(b, nx, ny)] & ~SOLVER_QUEUED) != SOLVER_OPEN) continue;
+            ud = solver_mask(s, nx, ny, x, y, &rd);
+            in = u & ud;
+            if (!in) continue;
+            a = u & ~in;
+            bb = ud & ~in;
+            na = __builtin_popcountll(a);
+            nb = __builtin_popcountll(bb);
+            ni = __builtin_popcountll(in);
+            lo = r - na > rd - nb ? r - na : rd - nb;
+            if (lo < 0) lo = 0;
+            hi = ni < r ? ni : r;
+            if (rd < hi) hi = rd;
+
+            if (bb && rd - hi == nb) {
+                solver_apply(s, bb, x, y, true);
+            } else if (bb && rd - lo == 0) {
+                solver_apply(s, bb, x, y, false);
+            } else if (a && r - hi == na) {
+                solver_apply(s, a, x, y, true);
+            } else if (a && r - lo == 0) {
+                solver_apply(s, a, x, y, false);
+            } else {
+                continue;
+            }
+            /* i's cells changed, and it was queued again if it still has any */
+            return;
+        }
+    }
+}
+
+/*
+ * Deduce until nothing more follows. Returns true once every safe cell
+ * is open.
+ */
+bool
+solver_run(struct solver *s)
+{
+    const struct board *b = s->b;
+    int x, y;
+
+    for (;;) {
+        while (s->nwork)
+            solver_step(s, s->work[--s->nwork]);
+        if (s->unknown == s->mines) return true;
+        if (s->mines) return false;
+
+        /* every mine is found, so whatever is covered is safe */
+        for (y = 0; y < b->h; y++)
+            for (x = 0; x < b->w; x++)
+                solver_open(s, board_index(b, x, y));
+    }
+}
+
+/*
+ * The solver is stuck: change the board where it is stuck. A covered
+ * cell next to an open one either gives its mine to a covered cell away
+ * from everything open, or takes one from there. What the solver knows
+ * stays true, so it carries on from where it was; only the numbers it
+ * was deduced from may have changed, which solver_noguess checks once
+ * the board is cleared.
+ */
+static bool
+solver_repair(struct solver *s, uint64_t *rng)
+{
+    struct board *b = s->b;
+    int around[8], n, k, nf, ni, x, y, i, f, t, c;
+    bool edge;
+
+    /* the frontier from the front of the list, the interior from the back */
+    nf = 0;
+    ni = 0;
+    for (y = 0; y < b->h; y++) {
+        for (x = 0; x < b->w; x++) {
+            i = board_index(b, x, y);
+            if (s->known[i] != SOLVER_COVERED) continue;
+            n = solver_around(b, i, around);
+            for (edge = false, k = 0; k < n && !edge; k++)
+                edge = (s->known[around[k]] & ~SOLVER_QUEUED) == SOLVER_OPEN;
+            if (edge)
+                s->list[nf++] = i;
+            else
+                s->list[b->w * b->h - ++ni] = i;
+        }
+    }
+    if (!nf || !ni) return false;
+
+    f = s->list[splitmix64(rng) % nf];
+    c = board_cell(b, f) == BOARD_MINE;
+    for (k = 0; k < 8; k++) {
+        t = s->list[b->w * b->h - 1 - splitmix64(rng) % ni];
+        if ((board_cell(b, t) == BOARD_MINE) != c) break;
+    }
+    if (k == 8) return false;
+
+    if (c)
+        board_move(b, f, t);
+    else
+        board_move(b, t, f);
+    solver_touch(s, f);
+    return true;
+}
+
+/*
+ * Build into b a board that solver_run clears from click, starting from
+ * the one seed makes, with the click's neighbourhood free of mines.
+ * Where the solver gets stuck the board is repaired rather than thrown
+ * away, up to SOLVER_REPAIRS times; a repaired board that gets cleared
+ * is solved again from the click, since repairs can change the numbers
+ * earlier deductions came from. Returns false if the board is given up,
+ * or once a lower attempt than s->attempt has passed (s->best).
+ */
+bool
+solver_noguess(struct solver *s, struct board *b, uint64_t seed, int click)
+{
+    uint64_t rng = splitmix64_at(seed, UINT64_MAX - 1);
+    bool repaired = false;
+    int k;
+
+    board_generate(b, seed);
+    board_clear(b, click, true);
+    solver_start(s, b);
+    solver_open(s, click);
+    for (k = 0; ; ) {
+        if (solver_run(s)) {
+            if (!repaired) {
+                board_label(b);
+                return true;
+            }
+            repaired = false;
+            solver_start(s, b);
+            solver_open(s, click);
+            continue;
+        }
+        if (k++ == SOLVER_REPAIRS || (s->best && __atomic_load_n(s->best, __ATOMIC_RELAXED) < s->attempt))
+            return false;
+        if (!solver_repair(s, &rng)) return false;
+        repaired = true;
+    }
+}
+
+size_t
+solver_frontier_memsize(int w, int h)
+{
+    size_t n = (size_t)w * h, cap = n < SOLVER_FRONTIER ? n : SOLVER_FRONTIER, capcon = n < 8 * cap ? n : 8 * cap;
+
+    return SOLVER_ALIGN(BOARD_CELLS(w, h) * sizeof(int))
+        + 7 * SOLVER_ALIGN(cap * sizeof(int)) + SOLVER_ALIGN(cap * sizeof(double))
+        + SOLVER_CHAINS * (2 * SOLVER_ALIGN(cap) + SOLVER_ALIGN(cap * sizeof(int)) + SOLVER_ALIGN(cap * sizeof(double)))
+        + SOLVER_ALIGN(cap * sizeof(struct solver_dist)) + SOLVER_ALIGN(SOLVER_NDIST(cap) * sizeof(double))
+        + SOLVER_ALIGN((cap + 1) * sizeof(double))
+        + SOLVER_ALIGN(cap * 8 * sizeof(int)) + 2 * SOLVER_ALIGN(cap)
+        + 5 * SOLVER_ALIGN(capcon * sizeof(int))
+        + SOLVER_ALIGN(SOLVER_BLOCKS(w, h) * sizeof(int))
+        + SOLVER_ALIGN(SOLVER_NPOOL(cap) * sizeof(double)) + SOLVER_ALIGN(SOLVER_MATRIX * sizeof(uint64_t));
+}
+
+void
+solver_frontier_init(struct solver_frontier *f, int w, int h, void *mem)
+{
+    unsigned char *p = mem;
+    size_t n = (size_t)w * h;
+    int k;
+
+    f->cap = n < SOLVER_FRONTIER ? n : SOLVER_FRONTIER;
+    f->capcon = n < 8 * (size_t)f->cap ? n : 8 * (size_t)f->cap;
+    f->slot = (int *)p;         p += SOLVER_ALIGN(BOARD_CELLS(w, h) * sizeof(int));
+    f->front = (int *)p;        p += SOLVER_ALIGN(f->cap * sizeof(int));
+    f->pos = (int *)p;          p += SOLVER_ALIGN(f->cap * sizeof(int));
+    f->order = (int *)p;        p += SOLVER_ALIGN(f->cap * sizeof(int));
+    f->part = (int *)p;         p += SOLVER_ALIGN(f->cap * sizeof(int));
+    f->col = (int *)p;          p += SOLVER_ALIGN(f->cap * sizeof(int));
+    f->sample = (int *)p;       p += SOLVER_ALIGN(f->cap * sizeof(int));
+    f->place = (int *)p;        p += SOLVER_ALIGN(f->cap * sizeof(int));
+    f->weight = (double *)p;    p += SOLVER_ALIGN((f->cap + 1) * sizeof(double));
+    for (k = 0; k < SOLVER_CHAINS; k++) {
+        f->chain[k].val = (signed char *)p;     p += SOLVER_ALIGN(f->cap);
+        f->chain[k].inblock = p;                p += SOLVER_ALIGN(f->cap);
+        f->chain[k].visits = (int *)p;          p += SOLVER_ALIGN(f->cap * sizeof(int));
+        f->chain[k].hits = (double *)p;         p += SOLVER_ALIGN(f->cap * sizeof(double));
+    }
+    f->prob = (double *)p;      p += SOLVER_ALIGN(f->cap * sizeof(double));
+    f->parts = (struct solver_dist *)p; p += SOLVER_ALIGN(f->cap * sizeof(struct solver_dist));
+    f->ndist = SOLVER_NDIST(f->cap);
+    f->dist = (double *)p;      p += SOLVER_ALIGN(f->ndist * sizeof(double));
+    f->ccon = (int *)p;         p += SOLVER_ALIGN(f->cap * 8 * sizeof(int));
+    f->nccon = p;               p += SOLVER_ALIGN(f->cap);
+    f->val = (signed char *)p;  p += SOLVER_ALIGN(f->cap);
+    f->con = (int *)p;          p += SOLVER_ALIGN(f->capcon * sizeof(int));
+    f->need = (int *)p;         p += SOLVER_ALIGN(f->capcon * sizeof(int));
+    f->open = (int *)p;         p += SOLVER_ALIGN(f->capcon * sizeof(int));
+    f->row = (int *)p;          p += SOLVER_ALIGN(f->capcon * sizeof(int));
+    f->rhs = (int *)p;          p += SOLVER_ALIGN(f->capcon * sizeof(int));
+    f->blk = (int *)p;          p += SOLVER_ALIGN(SOLVER_BLOCKS(w, h) * sizeof(int));
+    f->npool = SOLVER_NPOOL(f->cap);
+    f->pool = (double *)p;      p += SOLVER_ALIGN(f->npool * sizeof(double));
+    f->mat = (uint64_t *)p;
+
+    memset(f->slot, 0, BOARD_CELLS(w, h) * sizeof(int));
+    memset(f->row, 0xff, f->capcon * sizeof(int));
+    memset(f->col, 0xff, f->cap * sizeof(int));
+    memset(f->place, 0xff, f->cap * sizeof(int));
+    memset(f->cache, 0, sizeof(f->cache));
+    f->b = NULL;
+    f->nfront = 0;
+    f->ncon = 0;
+    f->nparts = 0;
+    f->top = 0;
+    f->at = 0;
+    f->lap = 1;
+    f->nsample = 0;
+    f->nchain = 0;
+    f->density = 0;
+    f->error = 0;
+}
+
+static inline bool
+solver_revealed(const struct solver_frontier *f, int i)
+{
+    return f->revealed[i >> 6] >> (i & 63) & 1;
+}
+
+/*
+ * Number i with its covered neighbours, which join the frontier. A number
+ * that would take it past f->cap is left out: fewer numbers allow more
+ * layouts, so what is certain stays certain.
+ */
+static void
+solver_frontier_add(struct solver_frontier *f, int i)
+{
+    int around[8], n, k, fresh;
+    bool covered = false;
+
+    n = solver_around(f->b, i, around);
+    for (fresh = 0, k = 0; k < n; k++) {
+        if (solver_revealed(f, around[k])) continue;
+        covered = true;
+        fresh += !f->slot[around[k]];
+    }
+    if (!covered || f->nfront + fresh > f->cap || f->ncon == f->capcon) return;
+
+    for (k = 0; k < n; k++) {
+        if (solver_revealed(f, around[k]) || f->slot[around[k]]) continue;
+        f->pos[f->nfront] = -1;
+        f->front[f->nfront++] = around[k];
+        f->slot[around[k]] = f->nfront;
+    }
+    f->slot[i] = -1 - f->ncon;
+    f->con[f->ncon++] = i;
+}
+
+/* the mines settled around number c */
+static int
+solver_settled(const struct solver_frontier *f, int c)
+{
+    int around[8], na, k, n = 0;
+
+    na = solver_around(f->b, c, around);
+    for (k = 0; k < na; k++)
+        n += f->slot[around[k]] > 0 && f->prob[f->slot[around[k]] - 1] == 1;
+    return n;
+}
+
+/*
+ * A first layout for a part the search found none for within its budget,
+ * by local search: start with no mines and, while some number is wrong,
+ * flip one of its cells that takes it closer, the one that leaves the
+ * numbers around it least wrong, or one at random an eighth of the time
+ * so it can't get stuck. The wrong numbers are kept in rhs, each at its
+ * place in row, and put back to -1 after. Leaves the layout in val[] and
+ * returns whether it got one within SOLVER_BUDGET flips.
+ */
+static bool
+solver_walk(struct solver_frontier *f, const int *order, int n)
+{
+    int near[8], nn, d, e, k, l, c, j, v, x, cost, best, nbest, pick, nwrong = 0;
+    long steps;
+    bool noise;
+    uint64_t rng = n;
+
+    for (d = 0; d < n; d++) {
+        f->col[order[d]] = d;
+        f->val[d] = 0;
+        for (k = 0; k < f->nccon[d]; k++) {
+            c = f->ccon[8 * d + k];
+            f->need[c] = board_cell(f->b, f->con[c]) - solver_settled(f, f->con[c]);
+        }
+    }
+    for (d = 0; d < n; d++) {
+        for (k = 0; k < f->nccon[d]; k++) {
+            c = f->ccon[8 * d + k];
+            if (!f->need[c] || f->row[c] != -1) continue;
+            f->row[c] = nwrong;
+            f->rhs[nwrong++] = c;
+        }
+    }
+
+    for (steps = 0; nwrong && steps < SOLVER_BUDGET; steps++) {
+        c = f->rhs[splitmix64(&rng) % nwrong];
+        v = f->need[c] > 0;
+        nn = solver_around(f->b, f->con[c], near);
+        noise = !(splitmix64(&rng) & 7);
+        best = 0;
+        nbest = 0;
+        pick = -1;
+        for (l = 0; l < nn; l++) {
+            if ((j = f->slot[near[l]] - 1) < 0 || f->col[j] < 0 || f->val[e = f->col[j]] == v) continue;
+            /* how much further off the numbers around it end up */
+            cost = 0;
+            for (k = 0; k < f->nccon[e] && !noise; k++) {
+                x = f->need[f->ccon[8 * e + k]];
+                cost += (v ? x > 0 : x < 0) ? -1 : 1;
+            }
+            if (pick < 0 || cost < best) {
+                best = cost;
+                nbest = 1;
+                pick = e;
+            } else if (cost == best && splitmix64(&rng) % ++nbest == 0) {
+                pick = e;
+            }
+        }
+        if (pick < 0) break;
+
+        f->val[pick] = v;
+        for (k = 0; k < f->nccon[pick]; k++) {
+            c = f->ccon[8 * pick + k];
+            f->need[c] -= v ? 1 : -1;
+            if (f->need[c] && f->row[c] == -1) {
+                f->row[c] = nwrong;
+                f->rhs[nwrong++] = c;
+            } else if (!f->need[c] && f->row[c] != -1) {
+                f->rhs[f->row[c]] = f->rhs[--nwrong];
+                f->row[f->rhs[nwrong]] = f->row[c];
+                f->row[c] = -1;
+            }
+        }
+    }
+
+    for (l = 0; l < nwrong; l++)
+        f->row[f->rhs[l]] = -1;
+    for (d = 0; d < n; d++)
+        f->col[order[d]] = -1;
+    return !nwrong;
+}
+
+/*
+ * Count the mine layouts of the unsettled cells whose frontier indices
+ * are order[0 .. n), depth first, cells in that order; the numbers around
+ * them see no other unsettled cells. Layouts are counted apart by how
+ * many mines they hold, since the mines left over elsewhere weigh each
+ * count differently. The part's record goes to dist[top]: n, the fewest
+ * mines kmin, how many counts nk there are, the layouts with kmin ..
+ * kmin + nk - 1 mines, then per cell its place in the component after
+ * first and the layouts of each count with a mine under it. Returns 1,
+ * or 2 when the search takes more than SOLVER_BUDGET steps, leaving the
+ * first layout it found in val[] to sample from, or solver_walk's if it
+ * found none. A part whose tallies don't fit in dist isn't counted at
+ * all: the search stops at the first layout and returns 2 with it. 0
+ * when there are no layouts, or none turned up either way.
+ */
+static int
+solver_enumerate(struct solver_frontier *f, const int *order, int n, int first)
+{
+    const struct board *b = f->b;
+    int around[8], na, d, k, c, km, kmin, kmax, nk, *cc;
+    size_t top = f->top, raw, row, seen;
+    double *w, *dist = f->dist;
+    long steps = 0;
+    bool ok, found = false, tally;
+
+    for (d = 0; d < n; d++) {
+        na = solver_around(b, f->front[order[d]], around);
+        f->nccon[d] = 0;
+        for (k = 0; k < na; k++) {
+            if (f->slot[around[k]] >= 0) continue;
+            c = -1 - f->slot[around[k]];
+            f->ccon[8 * d + f->nccon[d]++] = c;
+            f->need[c] = board_cell(b, f->con[c]) - solver_settled(f, f->con[c]);
+            f->open[c] = 0;
+        }
+        f->val[d] = -1;
+    }
+    /* no more mines than the numbers around the part ask for */
+    kmax = 0;
+    for (d = 0; d < n; d++) {
+        for (k = 0; k < f->nccon[d]; k++) {
+            c = f->ccon[8 * d + k];
+            if (!f->open[c]++) kmax += f->need[c];
+        }
+    }
+
+    /* the counts as they come, a row of kmax + 1 per cell, past where the record will go */
+    if (kmax > n) kmax = n;
+    row = kmax + 1;
+    raw = top + 3 + n;
+    seen = raw + (n + 1) * row;
+    tally = seen + n <= f->ndist;
+    if (tally) memset(dist + raw, 0, (n + 1) * row * sizeof(double));
+    w = dist + raw;
+
+    d = 0;
+    while (d >= 0) {
+        if (d == n) {
+            if (!tally) return 2;
+            for (km = 0, k = 0; k < n; k++)
+                km += f->val[k];
+            w[km] += 1;
+            for (k = 0; k < n; k++)
+                if (f->val[k]) w[(k + 1) * row + km] += 1;
+            for (k = 0; k < n && !found; k++)
+                dist[seen + k] = f->val[k];
+            found = true;
+            d--;
+            continue;
+        }
+        cc = &f->ccon[8 * d];
+        if (f->val[d] >= 0) {
+            for (k = 0; k < f->nccon[d]; k++) {
+                f->open[cc[k]]++;
+                f->need[cc[k]] += f->val[d];
+            }
+        }
+        if (++f->val[d] > 1) {
+            f->val[d] = -1;
+            d--;
+            continue;
+        }
+        if (++steps > SOLVER_BUDGET) {
+            for (k = 0; k < n && found; k++)
+                f->val[k] = dist[seen + k];
+            return found || solver_walk(f, order, n) ? 2 : 0;
+        }
+        ok = true;
+        for (k = 0; k < f->nccon[d]; k++) {
+            c = cc[k];
+            f->open[c]--;
+            f->need[c] -= f->val[d];
+            ok = ok && f->need[c] >= 0 && f->need[c] <= f->open[c];
+        }
+        if (ok) d++;
+    }
+
+    for (kmin = 0; kmin <= kmax && !w[kmin]; kmin++)
+        ;
+    if (kmin > kmax) return 0;
+    for (; !w[kmax]; kmax--)
+        ;
+    nk = kmax - kmin + 1;
+
+    /* packed down over the rows in place: nothing lands past where it is read from */
+    dist[top] = n;
+    dist[top + 1] = kmin;
+    dist[top + 2] = nk;
+    memmove(dist + top + 3, w + kmin, nk * sizeof(double));
+    for (d = 0; d < n; d++) {
+        dist[top + 3 + nk + (size_t)d * (1 + nk)] = f->pos[order[d]] - first;
+        memmove(dist + top + 4 + nk + (size_t)d * (1 + nk), w + (size_t)(d + 1) * row + kmin, nk * sizeof(double));
+    }
+    f->top = top + 3 + nk + (size_t)n * (1 + nk);
+    return 1;
+}
+
+#define SOLVER_POS(f, r, words) ((f)->mat + (size_t)(2 + 2 * (r)) * (words))
+#define SOLVER_NEG(f, r, words) (SOLVER_POS(f, r, words) + (words))
+
+/*
+ * Take the settled cells out of every equation, and settle the cells of
+ * any equation that leaves no choice: sum(pos) - sum(neg) = rhs can only
+ * reach |pos| with every pos cell a mine and no neg cell one, and -|neg|
+ * the other way round. Repeats until nothing new is settled.
+ */
+static void
+solver_settle(struct solver_frontier *f, int nrow, int words)
+{
+    uint64_t *mine = f->mat, *safe = f->mat + words, *p, *q, known;
+    int r, k, np, nq, v;
+    bool more;
+
+    do {
+        more = false;
+        for (r = 0; r < nrow; r++) {
+            p = SOLVER_POS(f, r, words);
+            q = SOLVER_NEG(f, r, words);
+            v = f->rhs[r];
+            np = 0;
+            nq = 0;
+            for (k = 0; k < words; k++) {
+                known = mine[k] | safe[k];
+                v -= __builtin_popcountll(p[k] & mine[k]) - __builtin_popcountll(q[k] & mine[k]);
+                p[k] &= ~known;
+                q[k] &= ~known;
+                np += __builtin_popcountll(p[k]);
+                nq += __builtin_popcountll(q[k]);
+            }
+            f->rhs[r] = v;
+            if ((!np && !nq) || (v != np && v != -nq)) continue;
+            for (k = 0; k < words; k++) {
+                mine[k] |= v == np ? p[k] : q[k];
+                safe[k] |= v == np ? q[k] : p[k];
+            }
+            more = true;
+        }
+    } while (more);
+}
+
+static void
+solver_swap(uint64_t *a, uint64_t *b, int words)
+{
+    uint64_t t;
+    int k;
+
+    for (k = 0; k < words; k++) {
+        t = a[k];
+        a[k] = b[k];
+        b[k] = t;
+    }
+}
+
+/*
+ * Row reduce the equations, Gauss-Jordan over the cells in order. Rows
+ * are a bitset of +1 cells and one of -1 cells, so adding or subtracting
+ * a pivot row is a few word ops; where it would make a coefficient of 2
+ * the row is left as it is, which only loses a deduction, never makes a
+ * wrong one.
+ */
+static void
+solver_reduce(struct solver_frontier *f, int n, int nrow, int words)
+{
+    uint64_t *mine = f->mat, *safe = f->mat + words, *pp, *pq, *p, *q, bit, clash, np, nq;
+    int col, wd, r, rank, k, c;
+
+    rank = 0;
+    for (col = 0; col < n && rank < nrow; col++) {
+        wd = col >> 6;
+        bit = 1ull << (col & 63);
+        if ((mine[wd] | safe[wd]) & bit) continue;
+        for (r = rank; r < nrow && !((SOLVER_POS(f, r, words)[wd] | SOLVER_NEG(f, r, words)[wd]) & bit); r++)
+            ;
+        if (r == nrow) continue;
+        if (r != rank) {
+            solver_swap(SOLVER_POS(f, r, words), SOLVER_POS(f, rank, words), 2 * words);
+            c = f->rhs[r];
+            f->rhs[r] = f->rhs[rank];
+            f->rhs[rank] = c;
+        }
+        pp = SOLVER_POS(f, rank, words);
+        pq = SOLVER_NEG(f, rank, words);
+        if (pq[wd] & bit) {
+            solver_swap(pp, pq, words);
+            f->rhs[rank] = -f->rhs[rank];
+        }
+
+        for (r = 0; r < nrow; r++) {
+            p = SOLVER_POS(f, r, words);
+            q = SOLVER_NEG(f, r, words);
+            if (r == rank || !((p[wd] | q[wd]) & bit)) continue;
+            c = p[wd] & bit ? 1 : -1;
+            for (clash = 0, k = 0; k < words; k++)
+                clash |= c > 0 ? (p[k] & pq[k]) | (q[k] & pp[k]) : (p[k] & pp[k]) | (q[k] & pq[k]);
+            if (clash) continue;
+            for (k = 0; k < words; k++) {
+                if (c > 0) {
+                    np = (p[k] & ~pp[k]) | (pq[k] & ~q[k]);
+                    nq = (q[k] & ~pq[k]) | (pp[k] & ~p[k]);
+                } else {
+                    np = (p[k] & ~pq[k]) | (pp[k] & ~q[k]);
+                    nq = (q[k] & ~pp[k]) | (pq[k] & ~p[k]);
+                }
+                p[k] = np;
+                q[k] = nq;
+            }
+            f->rhs[r] -= c * f->rhs[rank];
+        }
+        rank++;
+    }
+}
+
+/*
+ * Settle what the numbers prove about the unsettled cells set[0 .. m), as
+ * linear equations, in prob[] as 0 or 1. Numbers that also see unsettled
+ * cells outside the set are left out. Returns whether anything was
+ * settled, or -1 if the equations don't fit in SOLVER_MATRIX.
+ */
+static int
+solver_eliminate(struct solver_frontier *f, const int *set, int m)
+{
+    int around[8], near[8], na, nn, words = (m + 63) / 64, nrow, d, k, l, c, j, r, rhs, settled;
+    uint64_t *mine = f->mat, *safe = f->mat + words;
+    bool fits = true;
+
+    for (d = 0; d < m; d++)
+        f->col[set[d]] = d;
+
+    /* a number's equation, once, when all its unsettled cells are columns */
+    nrow = 0;
+    for (d = 0; d < m && fits; d++) {
+        na = solver_around(f->b, f->front[set[d]], around);
+        for (k = 0; k < na; k++) {
+            if (f->slot[around[k]] >= 0 || f->row[c = -1 - f->slot[around[k]]] != -1) continue;
+            f->row[c] = -2;
+            if ((size_t)(2 + 2 * (nrow + 1)) * words > SOLVER_MATRIX) {
+                fits = false;
+                break;
+            }
+            memset(SOLVER_POS(f, nrow, words), 0, 2 * words * sizeof(uint64_t));
+            rhs = board_cell(f->b, f->con[c]);
+            nn = solver_around(f->b, f->con[c], near);
+            for (l = 0; l < nn; l++) {
+                if ((j = f->slot[near[l]] - 1) < 0) continue;
+                if (f->prob[j] >= 0) {
+                    rhs -= f->prob[j] == 1;
+                } else if (f->col[j] < 0) {
+                    break;
+                } else {
+                    SOLVER_POS(f, nrow, words)[f->col[j] >> 6] |= 1ull << (f->col[j] & 63);
+                }
+            }
+            if (l < nn) continue;
+            f->row[c] = nrow;
+            f->rhs[nrow++] = rhs;
+        }
+    }
+
+    /* numbers back to no equation */
+    for (d = 0; d < m; d++) {
+        na = solver_around(f->b, f->front[set[d]], around);
+        for (k = 0; k < na; k++)
+            if (f->slot[around[k]] < 0) f->row[-1 - f->slot[around[k]]] = -1;
+    }
+    for (d = 0; d < m; d++)
+        f->col[set[d]] = -1;
+    if (!fits) return -1;
+
+    memset(mine, 0, 2 * words * sizeof(uint64_t));
+    solver_settle(f, nrow, words);
+    solver_reduce(f, m, nrow, words);
+    solver_settle(f, nrow, words);
+    settled = 0;
+    for (d = 0; d < m; d++) {
+        r = mine[d >> 6] >> (d & 63) & 1;
+        if (!r && !(safe[d >> 6] >> (d & 63) & 1)) continue;
+        f->prob[set[d]] = r;
+        settled = 1;
+    }
+    return settled;
+}
+
+/*
+ * solver_eliminate for a component too large to take whole: over every
+ * window of 2x2 blocks, so each number's cells are all in one of them,
+ * until a pass over them all settles nothing more. Fewer equations at a
+ * time find less, but what they find is as certain.
+ */
+static void
+solver_eliminate_windows(struct solver_frontier *f, const int *order, int n)
+{
+    const struct board *b = f->b;
+    int set[4 * SOLVER_WINDOW * SOLVER_WINDOW], x, y, x0, y0, x1, y1, bw, bh, bx, by, d, k, m, blk;
+    bool more;
+
+    /* the component's cells bucketed by block, in part[] */
+    x0 = b->w;
+    y0 = b->h;
+    x1 = 0;
+    y1 = 0;
+    for (d = 0; d < n; d++) {
+        board_xy(b, f->front[order[d]], &x, &y);
+        if (x < x0) x0 = x;
+        if (y < y0) y0 = y;
+        if (x > x1) x1 = x;
+        if (y > y1) y1 = y;
+    }
+    x0 /= SOLVER_WINDOW;
+    y0 /= SOLVER_WINDOW;
+    bw = x1 / SOLVER_WINDOW - x0 + 1;
+    bh = y1 / SOLVER_WINDOW - y0 + 1;
+    memset(f->blk, 0, ((size_t)bw * bh + 1) * sizeof(int));
+    for (d = 0; d < n; d++) {
+        board_xy(b, f->front[order[d]], &x, &y);
+        f->blk[(y / SOLVER_WINDOW - y0) * bw + x / SOLVER_WINDOW - x0 + 1]++;
+    }
+    for (k = 0; k < bw * bh; k++)
+        f->blk[k + 1] += f->blk[k];
+    for (d = 0; d < n; d++) {
+        board_xy(b, f->front[order[d]], &x, &y);
+        f->part[f->blk[(y / SOLVER_WINDOW - y0) * bw + x / SOLVER_WINDOW - x0]++] = order[d];
+    }
+    /* blk[k] is the end of block k now; shift back to starts */
+    for (k = bw * bh; k > 0; k--)
+        f->blk[k] = f->blk[k - 1];
+    f->blk[0] = 0;
+
+    do {
+        more = false;
+        for (by = 0; by < bh; by++) {
+            for (bx = 0; bx < bw; bx++) {
+                m = 0;
+                for (k = 0; k < 4; k++) {
+                    if (bx + (k & 1) >= bw || by + (k >> 1) >= bh) continue;
+                    blk = (by + (k >> 1)) * bw + bx + (k & 1);
+                    for (d = f->blk[blk]; d < f->blk[blk + 1]; d++)
+                        if (f->prob[f->part[d]] == SOLVER_UNSET) set[m++] = f->part[d];
+                }
+                if (m && solver_eliminate(f, set, m) > 0) more = true;
+            }
+        }
+    } while (more);
+}
+
+/* the unsettled cells joined to frontier index j through numbers, into part[]; returns how many */
+static int
+solver_part(struct solver_frontier *f, int j)
+{
+    int around[8], near[8], na, nn, k, l, m, head, end;
+
+    f->prob[j] = SOLVER_SEEN;
+    f->part[0] = j;
+    end = 1;
+    for (head = 0; head < end; head++) {
+        na = solver_around(f->b, f->front[f->part[head]], around);
+        for (k = 0; k < na; k++) {
+            if (f->slot[around[k]] >= 0) continue;
+            nn = solver_around(f->b, around[k], near);
+            for (l = 0; l < nn; l++) {
+                m = f->slot[near[l]] - 1;
+                if (m < 0 || f->prob[m] != SOLVER_UNSET) continue;
+                f->prob[m] = SOLVER_SEEN;
+                f->part[end++] = m;
+            }
+        }
+    }
+    return end;
+}
+
+/*
+ * The component order[0 .. n), with its cells at first on, solved into
+ * dist[top]: what elimination settles, then a search per part left. The
+ * record is a tag per cell, its prob if settled, -1 if left unsolved,
+ * SOLVER_PART if searched or SOLVER_SAMPLE less its mine in the layout
+ * found if its part is to be sampled, then how many parts were searched and their
+ * records from solver_enumerate. Returns false if dist has no room for
+ * the tags, leaving the component unsolved.
+ */
+static bool
+solver_solve(struct solver_frontier *f, const int *order, int n, int first)
+{
+    size_t at = f->top;
+    int d, e, m, npart, r;
+
+    if (at + n + 1 > f->ndist) {
+        for (d = 0; d < n; d++)
+            f->prob[order[d]] = -1;
+        return false;
+    }
+    f->top = at + n + 1;
+    for (d = 0; d < n; d++)
+        f->prob[order[d]] = SOLVER_UNSET;
+    if (solver_eliminate(f, order, n) < 0) solver_eliminate_windows(f, order, n);
+    for (npart = 0, d = 0; d < n; d++) {
+        if (f->prob[order[d]] != SOLVER_UNSET) continue;
+        m = solver_part(f, order[d]);
+        r = solver_enumerate(f, f->part, m, first);
+        npart += r == 1;
+        for (e = 0; e < m; e++)
+            f->prob[f->part[e]] = r == 1 ? SOLVER_PART : r == 2 ? SOLVER_SAMPLE - f->val[e] : -1;
+    }
+    for (d = 0; d < n; d++)
+        f->dist[at + d] = f->prob[order[d]];
+    f->dist[at + n] = npart;
+    return true;
+}
+
+/* a component's cells and numbers, all its answer depends on */
+static uint64_t
+solver_key(const struct solver_frontier *f, const int *order, int n)
+{
+    int around[8], na, d, k;
+    uint64_t key = n;
+
+    for (d = 0; d < n; d++) {
+        key = splitmix64_at(key, f->front[order[d]]);
+        na = solver_around(f->b, f->front[order[d]], around);
+        for (k = 0; k < na; k++)
+            if (f->slot[around[k]] < 0)
+                key = splitmix64_at(key, (uint64_t)around[k] << 4 | board_cell(f->b, around[k]));
+    }
+    return key;
+}
+
+static const struct solver_cached *
+solver_cache_find(const struct solver_frontier *f, uint64_t key, int n)
+{
+    const struct solver_cached *e = &f->cache[key % SOLVER_CACHE];
+
+    if (!e->lap || e->key != key || e->n != n) return NULL;
+    /* the pool is a ring: what the last lap left past the current spot is still there */
+    if (e->lap == f->lap || (e->lap == f->lap - 1 && e->at >= f->at)) return e;
+    return NULL;
+}
+
+/* the record at dist[at .. top) */
+static void
+solver_cache_store(struct solver_frontier *f, uint64_t key, int n, size_t at)
+{
+    struct solver_cached *e = &f->cache[key % SOLVER_CACHE];
+    size_t len = f->top - at;
+
+    if (len > f->npool) return;
+    if (f->at + len > f->npool) {
+        f->at = 0;
+        f->lap++;
+    }
+    e->key = key;
+    e->n = n;
+    e->len = len;
+    e->at = f->at;
+    e->lap = f->lap;
+    memcpy(f->pool + f->at, f->dist + at, len * sizeof(double));
+    f->at += len;
+}
+
+/*
+ * The record at dist[at] back into prob[] for the component order[0 ..
+ * n), its parts into the parts table with their cells' places turned into
+ * frontier indices.
+ */
+static void
+solver_load(struct solver_frontier *f, const int *order, int n, size_t at)
+{
+    struct solver_dist *p;
+    double *dist = f->dist;
+    int d, e, npart;
+
+    for (d = 0; d < n; d++)
+        f->prob[order[d]] = dist[at + d];
+    npart = dist[at + n];
+    at += n + 1;
+    while (npart--) {
+        p = &f->parts[f->nparts++];
+        p->m = dist[at];
+        p->kmin = dist[at + 1];
+        p->nk = dist[at + 2];
+        p->at = at + 3;
+        for (e = 0; e < p->m; e++)
+            dist[p->at + p->nk + (size_t)e * (1 + p->nk)] = order[(int)dist[p->at + p->nk + (size_t)e * (1 + p->nk)]];
+        at = p->at + p->nk + (size_t)p->m * (1 + p->nk);
+    }
+}
+
+/* the component of frontier index j into order[first ..), breadth first; returns its end */
+static int
+solver_component(struct solver_frontier *f, int j, int first)
+{
+    const struct board *b = f->b;
+    int around[8], near[8], na, nn, k, l, m, head, end;
+
+    f->pos[j] = first;
+    f->order[first] = j;
+    end = first + 1;
+    for (head = first; head < end; head++) {
+        na = solver_around(b, f->front[f->order[head]], around);
+        for (k = 0; k < na; k++) {
+            if (f->slot[around[k]] >= 0) continue;
+            nn = solver_around(b, around[k], near);
+            for (l = 0; l < nn; l++) {
+                m = f->slot[near[l]] - 1;
+                if (m < 0 || f->pos[m] >= 0) continue;
+                f->pos[m] = end;
+                f->order[end++] = m;
+            }
+        }
+    }
+    return end;
+}
+
+/*
+ * Scale v[0 .. n) to a largest term of 1. Terms too small to count
+ * become 0, so the tails of long products are skipped rather than
+ * carried as denormals.
+ */
+static void
+solver_normalise(double *v, int n)
+{
+    double max = 0;
+    int k;
+
+    for (k = 0; k < n; k++)
+        if (v[k] > max) max = v[k];
+    for (k = 0; k < n && max > 0; k++) {
+        v[k] /= max;
+        if (v[k] < SOLVER_TINY) v[k] = 0;
+    }
+}
+
+/*
+ * The layouts of parts lo .. hi together by their mines over kmin, the
+ * convolution of theirs, into dist[at], scaled to a largest term of 1.
+ * Returns its length, or -1 when dist has no room.
+ */
+static int
+solver_product(struct solver_frontier *f, int lo, int hi, size_t at)
+{
+    double *dist = f->dist, *a, *b, *out;
+    int mid, la, lb, k, l;
+
+    if (lo == hi) {
+        la = f->parts[lo].nk;
+        if (at + la > f->ndist) return -1;
+        memcpy(dist + at, dist + f->parts[lo].at, la * sizeof(double));
+        solver_normalise(dist + at, la);
+        return la;
+    }
+    mid = (lo + hi) / 2;
+    if ((la = solver_product(f, lo, mid, at)) < 0) return -1;
+    if ((lb = solver_product(f, mid + 1, hi, at + la)) < 0) return -1;
+    if (at + 2 * (size_t)(la + lb) > f->ndist) return -1;
+    a = dist + at;
+    b = a + la;
+    out = b + lb;
+    memset(out, 0, (la + lb - 1) * sizeof(double));
+    for (k = 0; k < la; k++) {
+        if (!a[k]) continue;
+        for (l = 0; l < lb; l++)
+            out[k + l] += a[k] * b[l];
+    }
+    memmove(a, out, (la + lb - 1) * sizeof(double));
+    solver_normalise(a, la + lb - 1);
+    return la + lb - 1;
+}
+
+/*
+ * A part's cells' chances with v[k] the weight of it holding kmin + k
+ * mines, everything else summed over; v NULL weighs them all the same.
+ */
+static void
+solver_finish(struct solver_frontier *f, const struct solver_dist *p, const double *v)
+{
+    const double *w = f->dist + p->at, *c;
+    double z, y;
+    int e, k;
+
+    for (z = 0, k = 0; k < p->nk; k++)
+        z += w[k] * (v ? v[k] : 1);
+    for (e = 0; e < p->m; e++) {
+        c = w + p->nk + (size_t)e * (1 + p->nk);
+        for (y = 0, k = 0; k < p->nk; k++)
+            y += c[1 + k] * (v ? v[k] : 1);
+        y = z > 0 ? y / z : 0;
+        f->prob[(int)c[0]] = y < 0 ? 0 : y > 1 ? 1 : y;
+    }
+}
+
+/*
+ * Hand the weights v[0 .. span of lo .. hi] at dist[at] down to the parts
+ * lo .. hi: each half gets them correlated with the other half's product,
+ * which sums over the other half's layouts.
+ */
+static bool
+solver_down(struct solver_frontier *f, int lo, int hi, size_t at)
+{
+    double *dist = f->dist, *v, *pl, *pr, *vl, *vr;
+    int mid, lv, la, lb, k, l;
+
+    if (lo == hi) {
+        solver_finish(f, &f->parts[lo], dist + at);
+        return true;
+    }
+    mid = (lo + hi) / 2;
+    for (lv = 1, k = lo; k <= hi; k++)
+        lv += f->parts[k].nk - 1;
+    if ((la = solver_product(f, lo, mid, at + lv)) < 0) return false;
+    if ((lb = solver_product(f, mid + 1, hi, at + lv + la)) < 0) return false;
+    if (at + lv + 2 * (size_t)(la + lb) > f->ndist) return false;
+    v = dist + at;
+    pl = v + lv;
+    pr = pl + la;
+    vl = pr + lb;
+    vr = vl + la;
+    memset(vl, 0, (la + lb) * sizeof(double));
+    for (l = 0; l < lb; l++) {
+        if (!pr[l]) continue;
+        for (k = 0; k < la; k++)
+            vl[k] += v[k + l] * pr[l];
+    }
+    for (l = 0; l < la; l++) {
+        if (!pl[l]) continue;
+        for (k = 0; k < lb; k++)
+            vr[k] += v[k + l] * pl[l];
+    }
+    solver_normalise(vl, la);
+    solver_normalise(vr, lb);
+
+    /* the right half's weights below the left's, which goes first */
+    memmove(v, vr, lb * sizeof(double));
+    memmove(v + lb, vl, la * sizeof(double));
+    return solver_down(f, lo, mid, at + lb) && solver_down(f, mid + 1, hi, at);
+}
+
+static double
+solver_lchoose(int n, int k)
+{
+    return lgamma(n + 1.0) - lgamma(k + 1.0) - lgamma(n - k + 1.0);
+}
+
+/*
+ * weight[] for the sampled cells, which so far counted as free: how
+ * likely the rest of the board makes each count of mines among them,
+ * given t[0 .. lt), the searched parts' layouts by their mines over their
+ * fewest, with left mines for those, the sampled and the nfree free cells.
+ * Kept as logs, -HUGE_VAL for none: the counts layouts hold can be far
+ * from the heaviest, too far for their weight next to it to be a double.
+ */
+static void
+solver_weigh(struct solver_frontier *f, const double *t, int lt, int left, int nfree)
+{
+    double *w = f->weight, max = -HUGE_VAL, m, sum, y;
+    int s, k, j;
+
+    for (s = 0; s <= f->nsample; s++) {
+        /* log of the sum over t, scaled by the largest term as it goes */
+        m = -HUGE_VAL;
+        sum = 0;
+        for (k = 0; k < lt; k++) {
+            j = left - s - k;
+            if (!t[k] || j < 0 || j > nfree) continue;
+            y = log(t[k]) + solver_lchoose(nfree, j);
+            if (y > m) {
+                sum = sum * exp(m - y) + 1;
+                m = y;
+            } else {
+                sum += exp(y - m);
+            }
+        }
+        w[s] = sum ? m + log(sum) : -HUGE_VAL;
+        if (w[s] > max) max = w[s];
+    }
+    f->heavy = 0;
+    for (s = 0; s <= f->nsample; s++) {
+        if (w[s] == max) f->heavy = s;
+        if (max == -HUGE_VAL) w[s] = 0;
+    }
+}
+
+/*
+ * The parts' chances, and the density of the free cells, given there
+ * are mines left once the settled ones are taken out. A layout of the
+ * parts with K mines leaves mines - K to the free cells, which can hold
+ * them choose(nfree, mines - K) ways, so that is its weight. Works in
+ * dist past top; returns false if there isn't room, or if no count of
+ * mines fits at all.
+ */
+static bool
+solver_combine(struct solver_frontier *f, int mines, int nfree)
+{
+    double *dist = f->dist, *v, *t, z, e, max;
+    int np, lv, k, left;
+
+    /* a part whose layouts all hold the same mines is weighed the same whichever it is */
+    for (np = 0, lv = 1, left = mines, k = 0; k < f->nparts; k++) {
+        left -= f->parts[k].kmin;
+        if (f->parts[k].nk == 1) {
+            solver_finish(f, &f->parts[k], NULL);
+            continue;
+        }
+        lv += f->parts[k].nk - 1;
+        f->parts[np++] = f->parts[k];
+    }
+    f->nparts = np;
+    if (f->top + 2 * (size_t)lv > f->ndist) return false;
+    v = dist + f->top;
+    for (max = -HUGE_VAL, k = 0; k < lv; k++) {
+        v[k] = left - k >= 0 && left - k <= nfree ? solver_lchoose(nfree, left - k) : -HUGE_VAL;
+        if (v[k] > max) max = v[k];
+    }
+    if (max == -HUGE_VAL) return false;
+    for (k = 0; k < lv; k++)
+        v[k] = exp(v[k] - max);
+
+    if (np) {
+        if (solver_product(f, 0, np - 1, f->top + lv) < 0) return false;
+        t = v + lv;
+    } else {
+        t = v + lv;
+        t[0] = 1;
+    }
+    for (z = 0, e = 0, k = 0; k < lv; k++) {
+        z += t[k] * v[k];
+        e += t[k] * v[k] * (left - k);
+    }
+    if (z <= 0) return false;
+    f->density = nfree ? e / z / nfree : 0;
+    if (f->nsample) solver_weigh(f, t, lv, left, nfree - f->nsample);
+    return !np || solver_down(f, 0, np - 1, f->top);
+}
+
+/*
+ * Work out the chance of a mine under every covered cell of b, given the
+ * cells in revealed and that mines of them are mines. Afterwards
+ * solver_prob() answers for any cell.
+ */
+void
+solver_analyse(struct solver_frontier *f, const struct board *b, const uint64_t *revealed, int mines)
+{
+    size_t words = BOARD_CELLS(b->w, b->h) / 64, wd, at;
+    const struct solver_cached *e;
+    const int *order;
+    uint64_t bits, key;
+    int first, end, n, k, i, covered, nfree, settled;
+    double expect, one;
+
+    /* the last position's slots */
+    for (k = 0; k < f->nsample; k++)
+        f->place[f->sample[k]] = -1;
+    for (k = 0; k < f->nfront; k++)
+        f->slot[f->front[k]] = 0;
+    for (k = 0; k < f->ncon; k++)
+        f->slot[f->con[k]] = 0;
+    f->b = b;
+    f->revealed = revealed;
+    f->nfront = 0;
+    f->ncon = 0;
+    f->nparts = 0;
+    f->nsample = 0;
+    f->nchain = 0;
+    f->error = 0;
+    f->top = 0;
+
+    covered = b->w * b->h;
+    for (wd = 0; wd < words; wd++) {
+        for (bits = revealed[wd]; bits; bits &= bits - 1) {
+            i = (int)(wd * 64) + __builtin_ctzll(bits);
+            covered--;
+            if (board_cell(b, i)) solver_frontier_add(f, i);
+        }
+    }
+
+    for (first = 0, k = 0; k < f->nfront; k++) {
+        if (f->pos[k] >= 0) continue;
+        end = solver_component(f, k, first);
+        order = f->order + first;
+        n = end - first;
+
+        key = solver_key(f, order, n);
+        e = solver_cache_find(f, key, n);
+        at = f->top;
+        if (e && at + e->len <= f->ndist) {
+            memcpy(f->dist + at, f->pool + e->at, e->len * sizeof(double));
+            f->top += e->len;
+            solver_load(f, order, n, at);
+        } else if (!e) {
+            if (solver_solve(f, order, n, first)) solver_cache_store(f, key, n, at);
+            if (f->top > at) solver_load(f, order, n, at);
+        } else {
+            for (i = 0; i < n; i++)
+                f->prob[order[i]] = -1;
+        }
+        first = end;
+    }
+
+    /* cells to sample count as free until they are, like unsolved ones */
+    for (k = 0; k < f->nfront; k++) {
+        if (f->prob[k] > SOLVER_SAMPLE) continue;
+        f->val[f->nsample] = SOLVER_SAMPLE - f->prob[k];
+        f->place[k] = f->nsample;
+        f->sample[f->nsample++] = k;
+        f->prob[k] = -1;
+    }
+    nfree = covered - f->nfront;
+    settled = 0;
+    for (k = 0; k < f->nfront; k++) {
+        nfree += f->prob[k] == -1;
+        settled += f->prob[k] == 1;
+    }
+    if (!solver_combine(f, mines - settled, nfree)) {
+        /* each part on its own, and the free cells share what they leave */
+        for (k = 0; k < f->nparts; k++)
+            solver_finish(f, &f->parts[k], NULL);
+        expect = mines;
+        for (k = 0; k < f->nfront; k++)
+            if (f->prob[k] >= 0) expect -= f->prob[k];
+        f->density = nfree ? expect / nfree : 0;
+        one = 1;
+        if (f->nsample) solver_weigh(f, &one, 1, (int)(expect + 0.5), nfree - f->nsample);
+    }
+    if (f->density < 0) f->density = 0;
+    if (f->density > 1) f->density = 1;
+    f->nfree = nfree;
+    f->expect = f->density * nfree;
+    for (k = 0; k < f->nfront; k++)
+        if (f->prob[k] == -1) f->prob[k] = f->density;
+}
+
+/*
+ * Sampled cells joined to sample s through numbers, breadth first up to
+ * SOLVER_BLOCK of them, into c's block with the numbers around them and
+ * what those still need from the block, given where the chain has the
+ * sampled mines outside it. A chain of cells that can only flip all at
+ * once fits in one block, where single cells would never move.
+ */
+static void
+solver_block(const struct solver_frontier *f, struct solver_chain *c, int s)
+{
+    const struct board *b = f->b;
+    int around[8], near[8], na, nn, d, k, l, e, j, need;
+
+    c->nblock = 1;
+    c->block[0] = s;
+    c->inblock[s] = 1;
+    for (d = 0; d < c->nblock && c->nblock < SOLVER_BLOCK; d++) {
+        na = solver_around(b, f->front[f->sample[c->block[d]]], around);
+        for (k = 0; k < na; k++) {
+            if (f->slot[around[k]] >= 0) continue;
+            nn = solver_around(b, around[k], near);
+            for (l = 0; l < nn && c->nblock < SOLVER_BLOCK; l++) {
+                if ((j = f->slot[near[l]] - 1) < 0 || (j = f->place[j]) < 0 || c->inblock[j]) continue;
+                c->inblock[j] = 1;
+                c->block[c->nblock++] = j;
+            }
+        }
+    }
+
+    c->nnum = 0;
+    for (d = 0; d < c->nblock; d++) {
+        na = solver_around(b, f->front[f->sample[c->block[d]]], around);
+        c->nccon[d] = 0;
+        for (k = 0; k < na; k++) {
+            if (f->slot[around[k]] >= 0) continue;
+            for (e = 0; e < c->nnum && c->num[e] != around[k]; e++)
+                ;
+            if (e == c->nnum) {
+                need = board_cell(b, around[k]);
+                nn = solver_around(b, around[k], near);
+                for (l = 0; l < nn; l++) {
+                    if ((j = f->slot[near[l]] - 1) < 0) continue;
+                    if (f->place[j] < 0)
+                        need -= f->prob[j] == 1;
+                    else if (!c->inblock[f->place[j]])
+                        need -= c->val[f->place[j]];
+                }
+                c->num[c->nnum] = around[k];
+                c->need[c->nnum] = need;
+                c->open[c->nnum++] = 0;
+            }
+            c->ccon[d][c->nccon[d]++] = e;
+            c->open[e]++;
+        }
+    }
+    for (d = 0; d < c->nblock; d++)
+        c->inblock[c->block[d]] = 0;
+}
+
+/*
+ * One heat bath step: every layout of the block that fits its numbers,
+ * the rest of the chain's layout held, weighed by the chain's mines with
+ * it next to its mines now, and one of them drawn for the chain. A chain
+ * can start with mines the rest of the board leaves no room for, where
+ * nothing weighs anything next to them; then it takes the layout nearest
+ * the count weighed most.
+ */
+static void
+solver_resample(const struct solver_frontier *f, struct solver_chain *c, int s)
+{
+    int v[SOLVER_BLOCK], d, k, km, n, rest, *cc, off, near = f->nsample + 1, ties = 0;
+    unsigned mask, pick = 0;
+    double total = 0, w, now = f->weight[c->mines];
+    bool ok;
+
+    solver_block(f, c, s);
+    n = c->nblock;
+    rest = c->mines;
+    for (d = 0; d < n; d++) {
+        pick |= (unsigned)c->val[c->block[d]] << d;
+        rest -= c->val[c->block[d]];
+        v[d] = -1;
+    }
+
+    d = 0;
+    km = 0;
+    mask = 0;
+    while (d >= 0) {
+        if (d == n) {
+            w = now > -HUGE_VAL ? exp(f->weight[rest + km] - now) : 0;
+            total += w;
+            if (w > 0 && (splitmix64(&c->rng) >> 11) * 0x1p-53 * total < w) pick = mask;
+            if (!total) {
+                off = rest + km > f->heavy ? rest + km - f->heavy : f->heavy - rest - km;
+                if (off <= near) {
+                    ties = off < near ? 1 : ties + 1;
+                    near = off;
+                    if (splitmix64(&c->rng) % ties == 0) pick = mask;
+                }
+            }
+            d--;
+            continue;
+        }
+        cc = c->ccon[d];
+        if (v[d] >= 0) {
+            for (k = 0; k < c->nccon[d]; k++) {
+                c->open[cc[k]]++;
+                c->need[cc[k]] += v[d];
+            }
+            km -= v[d];
+        }
+        if (++v[d] > 1) {
+            v[d] = -1;
+            d--;
+            continue;
+        }
+        km += v[d];
+        mask = (mask & ~(1u << d)) | (unsigned)v[d] << d;
+        ok = true;
+        for (k = 0; k < c->nccon[d]; k++) {
+            c->open[cc[k]]--;
+            c->need[cc[k]] -= v[d];
+            ok = ok && c->need[cc[k]] >= 0 && c->need[cc[k]] <= c->open[cc[k]];
+        }
+        if (ok) d++;
+    }
+    for (d = 0; d < n; d++)
+        c->val[c->block[d]] = pick >> d & 1;
+    c->mines = rest + __builtin_popcount(pick);
+}
+
+/*
+ * Set up nchain chains, at least 2, over the cells whose parts were too
+ * big to count, each from the layout the search found and with its own
+ * stream of seed. Returns false if there are none. The searched parts
+ * were weighed with these cells counted as free; the chains weigh these
+ * by the searched parts and the free cells.
+ */
+bool
+solver_sample_start(struct solver_frontier *f, int nchain, uint64_t seed)
+{
+    struct solver_chain *c;
+    int k, s;
+
+    if (!f->nsample) return false;
+    f->nchain = nchain < 2 ? 2 : nchain > SOLVER_CHAINS ? SOLVER_CHAINS : nchain;
+    for (k = 0; k < f->nchain; k++) {
+        c = &f->chain[k];
+        c->rng = splitmix64_at(seed, k);
+        c->mines = 0;
+        for (s = 0; s < f->nsample; s++) {
+            c->val[s] = f->val[s];
+            c->mines += f->val[s];
+            c->hits[s] = 0;
+            c->visits[s] = 0;
+            c->inblock[s] = 0;
+        }
+        c->at = 0;
+        c->passes = 0;
+    }
+    return true;
+}
+
+/*
+ * Move chain k on by steps redraws, around each sampled cell in turn,
+ * counting the mine of every cell in the block after each: a block drawn
+ * from all its layouts leaves each of its cells as likely a mine as the
+ * chain has it, not just the one it was drawn around. So a sweep redraws
+ * most cells about as many times as a block is large, and one is burn in
+ * enough, once the chain's mines weigh anything. Small steps keep a round
+ * short however many cells there are. Chains can run on threads of their
+ * own.
+ */
+void
+solver_sample_work(struct solver_frontier *f, int k, int steps)
+{
+    struct solver_chain *c = &f->chain[k];
+    int d, s;
+
+    while (steps--) {
+        solver_resample(f, c, c->at);
+        for (d = 0; d < c->nblock && c->passes >= SOLVER_BURN && f->weight[c->mines] > -HUGE_VAL; d++) {
+            s = c->block[d];
+            c->visits[s]++;
+            c->hits[s] += c->val[s];
+        }
+        if (++c->at == f->nsample) {
+            c->at = 0;
+            c->passes++;
+        }
+    }
+}
+
+/*
+ * The chains' tallies so far into prob[], and the free cells' density
+ * made up again around them. Returns the largest standard error of a
+ * sampled cell's chance, from how far apart the chains' own estimates
+ * are, so the chains' runs of similar layouts count as they should; 1
+ * while some chain has yet to count a cell, which keeps the density till
+ * then. An estimate of 0 or 1 proves nothing: it is kept half a visit
+ * away.
+ */
+double
+solver_sample_end(struct solver_frontier *f)
+{
+    double n, p, m, err, dev, expect;
+    int s, k, v;
+
+    err = 0;
+    expect = f->expect;
+    for (s = 0; s < f->nsample; s++) {
+        for (n = 0, p = 0, k = 0; k < f->nchain && (v = f->chain[k].visits[s]); k++) {
+            n += v;
+            p += f->chain[k].hits[s];
+        }
+        if (k < f->nchain) {
+            err = 1;
+            expect -= f->prob[f->sample[s]];
+            continue;
+        }
+        p /= n;
+        for (dev = 0, k = 0; k < f->nchain; k++) {
+            m = f->chain[k].hits[s] / f->chain[k].visits[s] - p;
+            dev += m * m;
+        }
+        dev = sqrt(dev / (f->nchain * (f->nchain - 1.0)));
+        if (dev > err) err = dev;
+        if (p < 0.5 / n) p = 0.5 / n;
+        if (p > 1 - 0.5 / n) p = 1 - 0.5 / n;
+        f->prob[f->sample[s]] = p;
+        expect -= p;
+    }
+    if (f->nfree > f->nsample) {
+        f->density = expect / (f->nfree - f->nsample);
+        if (f->density < 0) f->density = 0;
+        if (f->density > 1) f->density = 1;
+    }
+    f->error = err;
+    return err;
+}
+
+double
+solver_prob(const struct solver_frontier *f, int i)
+{
+    if (solver_revealed(f, i)) return 0;
+    if (f->slot[i] > 0) return f->prob[f->slot[i] - 1];
+    return f->density;
+}
+
+#endif